@@ -0,0 +1,389 @@
+/*
+ * Benchmark of the conversion pipeline on a synthetic corpus.
+ *
+ * Every corpus document is generated from a fixed seed, written to the corpus
+ * directory and then run through each stage separately: XML parse, svgpp
+ * traversal, flattening, formatting and writing. Each stage is repeated and
+ * its fastest run is reported together with its throughput, in MB of input
+ * for parsing and traversal, in vertices for flattening and formatting and
+ * in MB of output for writing.
+ *
+ * The path data of each document is also parsed on its own, once by
+ * src/path_data.cpp and once by svgpp's Spirit grammar, to compare the two.
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <boost/filesystem.hpp>
+#include <svgpp/parser/grammar/path_data.hpp>
+
+#include "svg_reader.hpp"
+#include "flatten.hpp"
+#include "output.hpp"
+#include "mapped_file.hpp"
+#include "path_data.hpp"
+
+namespace {
+  typedef std::chrono::steady_clock bench_clock;
+
+  struct document {
+    std::string name;
+    std::string fpath;
+    size_t size;
+  };
+
+  // coordinates printed with a fixed number of decimals, as editors do
+  class svg_builder {
+    private:
+      std::string m_text;
+      std::mt19937 m_random;
+
+    public:
+      explicit svg_builder(unsigned seed) : m_random(seed) {
+        m_text = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+          "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"1000\" height=\"1000\">\n";
+      }
+
+      double uniform(double min, double max) {
+        return std::uniform_real_distribution<double>(min, max)(m_random);
+      }
+
+      svg_builder& number(double value) {
+        char buf[32];
+        m_text.append(buf, std::snprintf(buf, sizeof(buf), "%.3f", value));
+        return *this;
+      }
+
+      svg_builder& point(double min, double max) {
+        number(uniform(min, max));
+        m_text += ',';
+        return number(uniform(min, max));
+      }
+
+      svg_builder& operator<<(const char* str) {
+        m_text += str;
+        return *this;
+      }
+
+      svg_builder& operator<<(char c) {
+        m_text += c;
+        return *this;
+      }
+
+      std::string finish() {
+        m_text += "</svg>\n";
+        return std::move(m_text);
+      }
+  }; /* class svg_builder */
+
+  // many small translated icons made of lines and cubic curves
+  std::string icons(size_t scale) {
+    svg_builder svg(1);
+    for (size_t i = 0; i < 2000 * scale; ++i) {
+      svg << "<g transform=\"translate(";
+      svg.point(0, 1000) << ")\"><path fill=\"none\" stroke=\"black\" d=\"M";
+      svg.point(0, 24);
+      for (int k = 0; k < 6; ++k) {
+        svg << (k % 2 ? " L" : " C");
+        svg.point(0, 24);
+        if (k % 2 == 0) {
+          svg << ' ';
+          svg.point(0, 24) << ' ';
+          svg.point(0, 24);
+        }
+      }
+      svg << " Z\"/><circle cx=\"12\" cy=\"12\" r=\"";
+      svg.number(svg.uniform(1, 4)) << "\"/></g>\n";
+    }
+    return svg.finish();
+  }
+
+  // one path with a very long d attribute, as plotter and tracing output has
+  std::string huge_path(size_t scale) {
+    svg_builder svg(2);
+    svg << "<path fill=\"none\" stroke=\"black\" d=\"M";
+    svg.point(0, 1000);
+    for (size_t i = 0; i < 200000 * scale; ++i) {
+      switch (i % 4) {
+        case 0:
+          svg << " L";
+          svg.point(0, 1000);
+          break;
+        case 1:
+          svg << " Q";
+          svg.point(0, 1000) << ' ';
+          svg.point(0, 1000);
+          break;
+        default:
+          svg << " C";
+          svg.point(0, 1000) << ' ';
+          svg.point(0, 1000) << ' ';
+          svg.point(0, 1000);
+      }
+    }
+    svg << "\"/>\n";
+    return svg.finish();
+  }
+
+  // paths made of elliptical arcs of every flag combination
+  std::string arcs(size_t scale) {
+    svg_builder svg(3);
+    for (size_t i = 0; i < 20000 * scale; ++i) {
+      svg << "<path fill=\"none\" stroke=\"black\" d=\"M";
+      svg.point(0, 1000);
+      for (int k = 0; k < 4; ++k) {
+        svg << " A";
+        svg.point(5, 50) << ' ';
+        svg.number(svg.uniform(0, 360)) << (k & 1 ? " 1," : " 0,") << (k & 2 ? "1 " : "0 ");
+        svg.point(0, 1000);
+      }
+      svg << "\"/>\n";
+    }
+    return svg.finish();
+  }
+
+  // deeply nested groups, each adding a transform, with shapes at every level
+  std::string nested_groups(size_t scale) {
+    static constexpr int DEPTH = 100;
+    svg_builder svg(4);
+    for (size_t i = 0; i < 100 * scale; ++i) {
+      for (int d = 0; d < DEPTH; ++d) {
+        svg << "<g transform=\"rotate(";
+        svg.number(svg.uniform(-5, 5)) << ") translate(";
+        svg.point(-2, 2) << ")\"><rect x=\"";
+        svg.number(svg.uniform(0, 900)) << "\" y=\"";
+        svg.number(svg.uniform(0, 900)) << "\" width=\"10\" height=\"10\" rx=\"2\"/>\n";
+      }
+      for (int d = 0; d < DEPTH; ++d) svg << "</g>";
+      svg << '\n';
+    }
+    return svg.finish();
+  }
+
+  // path events that are only counted, so that parsing is all that is timed
+  class event_counter final : public path_data::events<double> {
+    private:
+      typedef svgpp::tag::coordinate::absolute absolute;
+      typedef svgpp::tag::coordinate::relative relative;
+
+    public:
+      size_t n = 0;
+
+      void path_move_to(double, double, absolute) override { ++n; }
+      void path_move_to(double, double, relative) override { ++n; }
+      void path_line_to(double, double, absolute) override { ++n; }
+      void path_line_to(double, double, relative) override { ++n; }
+      void path_line_to_ortho(double, bool, absolute) override { ++n; }
+      void path_line_to_ortho(double, bool, relative) override { ++n; }
+      void path_cubic_bezier_to(double, double, double, double, double, double, absolute) override {
+        ++n;
+      }
+      void path_cubic_bezier_to(double, double, double, double, double, double, relative) override {
+        ++n;
+      }
+      void path_cubic_bezier_to(double, double, double, double, absolute) override { ++n; }
+      void path_cubic_bezier_to(double, double, double, double, relative) override { ++n; }
+      void path_quadratic_bezier_to(double, double, double, double, absolute) override { ++n; }
+      void path_quadratic_bezier_to(double, double, double, double, relative) override { ++n; }
+      void path_quadratic_bezier_to(double, double, absolute) override { ++n; }
+      void path_quadratic_bezier_to(double, double, relative) override { ++n; }
+      void path_elliptical_arc_to(
+          double, double, double, bool, bool, double, double, absolute) override { ++n; }
+      void path_elliptical_arc_to(
+          double, double, double, bool, bool, double, double, relative) override { ++n; }
+      void path_close_subpath() override { ++n; }
+      void path_exit() override {}
+  }; /* class event_counter */
+
+  typedef svgpp::path_data_grammar<
+    const char*,
+    path_data::events<double>,
+    double,
+    svgpp::policy::path_events::forward_to_method<path_data::events<double> >
+      > spirit_path_grammar;
+
+  bool spirit_parse(const char*& it, const char* end, path_data::events<double>& events) {
+    static const spirit_path_grammar grammar;
+    return boost::spirit::qi::phrase_parse(it, end, grammar(boost::phoenix::ref(events)),
+        spirit_path_grammar::skipper_type());
+  }
+
+  // the d attributes of every element under node
+  void find_path_data(
+      const rapidxml_ns::xml_node<>* node,
+      std::vector<std::pair<const char*, size_t>>& path_data) {
+    for (const rapidxml_ns::xml_attribute<>* a = node->first_attribute(); a;
+        a = a->next_attribute()) {
+      if (a->local_name_size() == 1 && a->local_name()[0] == 'd') {
+        path_data.emplace_back(a->value(), a->value_size());
+      }
+    }
+    for (const rapidxml_ns::xml_node<>* child = node->first_node(); child;
+        child = child->next_sibling()) {
+      find_path_data(child, path_data);
+    }
+  }
+
+  void write_file(const std::string& fpath, const std::string& text) {
+    output::writer out(fpath);
+    out << text;
+    out.flush();
+  }
+
+  // fastest of n_runs runs of fn, in seconds
+  double time_best(size_t n_runs, const std::function<void()>& fn) {
+    double best = 0;
+    for (size_t i = 0; i < n_runs; ++i) {
+      const bench_clock::time_point start = bench_clock::now();
+      fn();
+      const double elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+      if (i == 0 || elapsed < best) best = elapsed;
+    }
+    return best;
+  }
+
+  void print_stage(const char* stage, double seconds, double amount, const char* unit) {
+    std::printf("  %-10s %10.3f ms %12.2f %s\n", stage, 1e3 * seconds, amount / seconds, unit);
+  }
+
+  void run(const document& doc, size_t n_runs, const std::string& output_fpath) {
+    const double megabytes = doc.size / 1e6;
+
+    const double parse = time_best(n_runs, [&] {
+      input::mapped_file file(doc.fpath);
+      rapidxml_ns::xml_document<> xml;
+      // as svg::reader parses, so that the traversal estimate below holds
+      xml.set_skip_contents(svg::skips_contents);
+      xml.parse<svg::PARSE_FLAGS>(file.data());
+    });
+
+    svg::reader reader;
+    const double load = time_best(n_runs, [&] { reader.load_file(doc.fpath); });
+    // load_file parses too; the difference is an estimate of the traversal alone
+    const double traverse = std::max(load - parse, 1e-9);
+    const svg::path& path = reader.actions();
+
+    std::vector<flatten::vertex> vertices;
+    const flatten::options flatten_opts;
+    const double flatten_time = time_best(n_runs, [&] {
+      vertices.clear();
+      flatten::builder builder(vertices, flatten_opts);
+      path.visit(builder, { 0, path.size(), 0 });
+      builder.finish();
+    });
+
+    // the subpath lists of svg2scad's default output
+    std::string text;
+    const double format = time_best(n_runs, [&] {
+      text.clear();
+      output::writer out([&text](const char* data, size_t n) { text.append(data, n); });
+      for (size_t first = 0, last; first < vertices.size(); first = last) {
+        for (last = first + 1; last < vertices.size() && !vertices[last].moveflag; ++last) {}
+        out << "svg_curve([";
+        for (size_t i = first; i < last; ++i) {
+          if (i > first) out << ',';
+          out << '[' << vertices[i].position.x << ',' << vertices[i].position.y << ']';
+        }
+        out << "],thickness,depth);\n";
+      }
+      out.flush();
+    });
+
+    const double write = time_best(n_runs, [&] { write_file(output_fpath, text); });
+
+    input::mapped_file file(doc.fpath);
+    rapidxml_ns::xml_document<> xml;
+    xml.parse<svg::PARSE_FLAGS>(file.data());
+    std::vector<std::pair<const char*, size_t>> path_data;
+    find_path_data(&xml, path_data);
+    double path_megabytes = 0;
+    for (const auto& d : path_data) path_megabytes += d.second / 1e6;
+    auto time_path_data = [&](bool (*parse)(const char*&, const char*, path_data::events<double>&)) {
+      return time_best(n_runs, [&] {
+        event_counter events;
+        for (const auto& d : path_data) {
+          const char* it = d.first;
+          if (!parse(it, d.first + d.second, events) || it != d.first + d.second) {
+            throw std::runtime_error("path data benchmark: malformed path data");
+          }
+        }
+      });
+    };
+    const double path_spirit = time_path_data(spirit_parse);
+    const double path_parser = time_path_data(path_data::parse<double>);
+
+    std::printf("%s: %.2f MB, %zu commands, %zu vertices, %.2f MB output\n",
+        doc.name.c_str(), megabytes, path.size(), vertices.size(), text.size() / 1e6);
+    print_stage("parse", parse, megabytes, "MB/s");
+    print_stage("traverse", traverse, megabytes, "MB/s");
+    print_stage("flatten", flatten_time, vertices.size(), "vertices/s");
+    print_stage("format", format, vertices.size(), "vertices/s");
+    print_stage("write", write, text.size() / 1e6, "MB/s");
+    if (!path_data.empty()) {
+      print_stage("d spirit", path_spirit, path_megabytes, "MB/s");
+      print_stage("d parser", path_parser, path_megabytes, "MB/s");
+    }
+  }
+
+  void print_help_and_exit() {
+    std::cerr << "usage: svg2scad_bench [OPTIONS]\n"
+      "\t-c, --corpus\tDirectory the corpus and scratch output are written to."
+      " Default is svg2scad_bench_corpus.\n"
+      "\t-s, --scale\tMultiply the size of every corpus document. Default is 1.\n"
+      "\t-r, --runs\tNumber of runs of every stage, of which the fastest is reported."
+      " Default is 5.\n"
+      "\t-h, --help\tPrint help text and exit with failure\n";
+    exit(1);
+  }
+} /* namespace */
+
+int main(int argc, char** argv) {
+  std::string corpus_dir = "svg2scad_bench_corpus";
+  size_t scale = 1;
+  size_t n_runs = 5;
+  for (int i = 1; i < argc; ++i) {
+    if (i + 1 < argc && (!strcmp(argv[i], "-c") || !strcmp(argv[i], "--corpus"))) {
+      corpus_dir = argv[++i];
+    } else if (i + 1 < argc && (!strcmp(argv[i], "-s") || !strcmp(argv[i], "--scale"))) {
+      scale = std::max(1, atoi(argv[++i]));
+    } else if (i + 1 < argc && (!strcmp(argv[i], "-r") || !strcmp(argv[i], "--runs"))) {
+      n_runs = std::max(1, atoi(argv[++i]));
+    } else {
+      print_help_and_exit();
+    }
+  }
+
+  try {
+    boost::filesystem::create_directories(corpus_dir);
+    const std::pair<const char*, std::string (*)(size_t)> generators[] = {
+      { "icons", icons },
+      { "huge_path", huge_path },
+      { "arcs", arcs },
+      { "nested_groups", nested_groups }
+    };
+    std::vector<document> corpus;
+    for (const auto& generator : generators) {
+      const std::string text = generator.second(scale);
+      const std::string fpath = (boost::filesystem::path(corpus_dir) / generator.first).string()
+        + ".svg";
+      write_file(fpath, text);
+      corpus.push_back({ generator.first, fpath, text.size() });
+    }
+
+    const std::string output_fpath = (boost::filesystem::path(corpus_dir) / "out.scad").string();
+    for (const document& doc : corpus) run(doc, n_runs, output_fpath);
+  } catch (const std::exception& e) {
+    std::cerr << "error: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
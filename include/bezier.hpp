@@ -7,25 +7,65 @@
 namespace bezier {
   using namespace math;
 
-  vector2f curve(std::vector<vector2f> points, float t);
+  vector2f curve(std::vector<vector2f> points, Float t);
 
-  vector2f elliptical_curve(
+  /*
+   * SVG elliptical arc converted once from endpoint to center parameterization,
+   * see https://www.w3.org/TR/SVG/implnote.html#ArcConversionEndpointToCenter
+   * x_axis_rotation is in degrees as in the SVG arc command. Arcs with a zero
+   * radius degenerate to the straight line from p0 to p1.
+   */
+  class elliptical_arc {
+    private:
+      vector2f m_p0, m_p1;
+      vector2f m_center;
+      vector2f m_r;
+      Float m_cos_phi = 1.0f;
+      Float m_sin_phi = 0.0f;
+      Float m_theta0  = 0.0f;
+      Float m_dtheta  = 0.0f;
+      bool m_is_line  = false;
+
+    public:
+      elliptical_arc(
+          const vector2f& p0,
+          const vector2f& p1,
+          const vector2f& r,
+          bool large_arc_flag,
+          bool sweep_flag,
+          Float x_axis_rotation);
+
+      vector2f point(Float t) const;
+
+      // write n samples at t = 1/n, ..., 1 by rotating with a fixed angle step
+      void samples(size_t n, vector2f* out) const;
+
+      bool is_line() const { return m_is_line; }
+      const vector2f& radii() const { return m_r; }
+      Float sweep_angle() const { return m_dtheta; }
+  };
+
+  inline vector2f elliptical_curve(
       const vector2f& p0,
       const vector2f& p1,
       const vector2f& r,
       bool large_arc_flag,
       bool sweep_flag,
-      float x_axis_rotation,
-      float t
-      );
+      Float x_axis_rotation,
+      Float t
+      )
+  {
+    return elliptical_arc(p0, p1, r, large_arc_flag, sweep_flag, x_axis_rotation).point(t);
+  }
 
   inline vector2f quadratic_curve(
       const vector2f& p0,
       const vector2f& p1,
       const vector2f& p2,
-      float t)
+      Float t)
   {
-    return curve({ p0, p1, p2 }, t);
+    const Float mt = 1.0f - t;
+    return (mt * mt) * p0 + (2.0f * mt * t) * p1 + (t * t) * p2;
   }
 
   inline vector2f cubic_curve(
@@ -33,10 +73,69 @@ namespace bezier {
       const vector2f& p1,
       const vector2f& p2,
       const vector2f& p3,
-      float t)
+      Float t)
   {
-    return curve({ p0, p1, p2, p3 }, t);
+    const Float mt = 1.0f - t;
+    return (mt * mt * mt) * p0 + (3.0f * mt * mt * t) * p1 + (3.0f * mt * t * t) * p2
+      + (t * t * t) * p3;
   }
+
+  /*
+   * Write n samples at t = 1/n, 2/n, ..., 1 into out using forward differencing.
+   * The differences are accumulated in double precision and the last sample is
+   * pinned to the end point so long runs do not drift.
+   */
+  void quadratic_curve_samples(
+      const vector2f& p0,
+      const vector2f& p1,
+      const vector2f& p2,
+      size_t n,
+      vector2f* out);
+
+  void cubic_curve_samples(
+      const vector2f& p0,
+      const vector2f& p1,
+      const vector2f& p2,
+      const vector2f& p3,
+      size_t n,
+      vector2f* out);
+
+  /*
+   * Up to WIDTH cubic segments in structure-of-arrays layout so that
+   * cubic_batch_samples can flatten them side by side in SIMD lanes.
+   */
+  struct cubic_batch {
+    static constexpr size_t WIDTH = 8;
+
+    alignas(32) Float x[4][WIDTH] = {};
+    alignas(32) Float y[4][WIDTH] = {};
+    size_t n_segments[WIDTH] = {};
+    size_t size = 0;
+
+    bool full() const {
+      return size == WIDTH;
+    }
+
+    void push(
+        const vector2f& p0,
+        const vector2f& p1,
+        const vector2f& p2,
+        const vector2f& p3,
+        size_t n)
+    {
+      ASSERT(size < WIDTH);
+      x[0][size] = p0.x; x[1][size] = p1.x; x[2][size] = p2.x; x[3][size] = p3.x;
+      y[0][size] = p0.y; y[1][size] = p1.y; y[2][size] = p2.y; y[3][size] = p3.y;
+      n_segments[size] = n;
+      ++size;
+    }
+  };
+
+  /*
+   * Same as cubic_curve_samples for every segment of the batch, writing
+   * batch.n_segments[i] samples into out[i]. Uses AVX or SSE when available.
+   */
+  void cubic_batch_samples(const cubic_batch& batch, vector2f* const* out);
 }
 
 #endif /* BEZIER_HPP */
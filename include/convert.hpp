@@ -0,0 +1,111 @@
+#ifndef CONVERT_HPP
+#define CONVERT_HPP
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "svg_reader.hpp"
+#include "flatten.hpp"
+#include "output.hpp"
+#include "thread_pool.hpp"
+#include "stats.hpp"
+
+namespace convert {
+  using namespace math;
+
+  static const char DEFAULT_MODULE_NAME[] = "svg_generated";
+
+  enum output_format {
+    FORMAT_SCAD,
+    FORMAT_STL,
+    FORMAT_3MF
+  };
+
+  struct scad_options {
+    flatten::options flatten;
+    output_format format = FORMAT_SCAD;
+    // extrusion depth of STL and 3MF output
+    Float depth = 1;
+    // fill shapes with one polygon() each instead of tracing subpaths with svg_curve
+    bool polygons = false;
+    // if positive, outline every shape with this width in place of its own stroke
+    Float stroke_width = 0;
+    // if positive, drop flattened vertices closer than this to the simplified subpath
+    Float simplify_tolerance = 0;
+    // print repeated geometry once as a module placed with translate()
+    bool dedupe = false;
+    // if not null, collects what --stats reports
+    stats::counters* stats = nullptr;
+  };
+
+  // calls its argument with the path of a whole document, or of each of its chunks
+  typedef std::function<void(const svg::reader::chunk_handler&)> path_source;
+
+  /*
+   * Write one SVG document in the format chosen by opts. paths delivers the
+   * document from reader, which also holds its <use> definitions. Binary STL
+   * is written in one pass if fd is the seekable file behind out, and is held
+   * in memory until complete otherwise. vertices is only scratch space.
+   */
+  void print_document(
+      output::writer& out,
+      int fd,
+      svg::reader& reader,
+      const path_source& paths,
+      const std::string& module_name,
+      const scad_options& opts,
+      std::vector<flatten::vertex>& vertices,
+      thread_pool* pool);
+
+  // file name extension of format, including the dot
+  const char* format_extension(output_format format);
+
+  /*
+   * In-process conversion of SVG documents held in memory, for callers that
+   * convert many of them. Output goes to a sink given with each document; the
+   * reader, output buffer and scratch space are reused from one document to
+   * the next. A converter must not be used by several threads at once, but
+   * several converters may share one thread pool. Errors are thrown as
+   * std::exception, after which the converter may be used again.
+   */
+  class converter {
+    private:
+      const scad_options m_opts;
+      thread_pool* const m_pool;
+      svg::reader m_reader;
+      std::vector<flatten::vertex> m_vertices;
+      output::writer m_out;
+
+      void print(
+          const output::sink& sink,
+          const path_source& paths,
+          const std::string& module_name);
+
+    public:
+      explicit converter(
+          const scad_options& opts = scad_options(),
+          int precision = 6,
+          thread_pool* pool = nullptr);
+
+      /*
+       * Convert the document in [svg, svg + size), which need not be null
+       * terminated. If its last byte is a null character it is read where it
+       * is, which may be read-only or shared memory, without a copy.
+       */
+      void convert(
+          const char* svg,
+          size_t size,
+          const output::sink& sink,
+          const std::string& module_name = DEFAULT_MODULE_NAME);
+
+      // as convert(), reading the document in chunks as --stream does
+      void convert_streamed(
+          const char* svg,
+          size_t size,
+          const output::sink& sink,
+          const std::string& module_name = DEFAULT_MODULE_NAME);
+  }; /* class converter */
+} /* namespace convert */
+
+#endif /* CONVERT_HPP */
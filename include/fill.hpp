@@ -0,0 +1,35 @@
+#ifndef FILL_HPP
+#define FILL_HPP
+
+#include <vector>
+
+#include "flatten.hpp"
+#include "svg_path.hpp"
+
+namespace fill {
+  using namespace math;
+
+  // vertices [first, last) of one implicitly closed outline
+  struct ring {
+    size_t first;
+    size_t last;
+  };
+
+  /*
+   * Split flattened vertices into rings at every subpath start. A last vertex
+   * repeating the first one is left out, as are rings enclosing no area.
+   */
+  void collect_rings(const std::vector<flatten::vertex>& vertices, std::vector<ring>& rings);
+
+  /*
+   * Drop rings so that filling the rest with the even-odd rule, which is what
+   * OpenSCAD's polygon() does with several paths, covers the same area as
+   * filling all of them with fill_rule. Exact as long as no two rings cross.
+   */
+  void select_rings(
+      const std::vector<flatten::vertex>& vertices,
+      svg::style::fill_rule_type fill_rule,
+      std::vector<ring>& rings);
+} /* namespace fill */
+
+#endif /* FILL_HPP */
@@ -0,0 +1,76 @@
+#ifndef FLATTEN_HPP
+#define FLATTEN_HPP
+
+#include <vector>
+
+#include "svg_path.hpp"
+#include "bezier.hpp"
+
+namespace flatten {
+  using namespace math;
+
+  struct options {
+    size_t n_segments = 10;
+    // maximum chordal deviation; curves are split into n_segments if not positive
+    Float tolerance = 0;
+  };
+
+  struct vertex {
+    vector2f position;
+    bool moveflag = false;  // first vertex of a subpath
+    bool closeflag = false; // last vertex of a subpath ended by close_subpath
+  };
+
+  // number of segments needed to keep a curve within opts.tolerance (Wang's formula)
+  size_t quadratic_segments(
+      const vector2f& p0,
+      const vector2f& p1,
+      const vector2f& p2,
+      const options& opts);
+
+  size_t cubic_segments(
+      const vector2f& p0,
+      const vector2f& p1,
+      const vector2f& p2,
+      const vector2f& p3,
+      const options& opts);
+
+  // number of segments needed to keep an arc's sagitta within opts.tolerance
+  size_t arc_segments(const bezier::elliptical_arc& arc, const options& opts);
+
+  /*
+   * Path visitor that turns every command into polyline vertices, appending
+   * them to the given vector. A vertex with moveflag set starts a new subpath.
+   * Cubic segments are queued and flattened in SIMD batches into slots reserved
+   * in the output, so finish() must be called once the path has been visited.
+   */
+  class builder {
+    private:
+      std::vector<vertex>& m_vertices;
+      const options m_options;
+      vector2f m_marker;
+      vector2f m_subpath_start;
+      bool m_reopen = false; // drawing after close_subpath starts a new subpath
+      std::vector<vector2f> m_samples; // scratch buffer reused across curves
+      bezier::cubic_batch m_cubics;
+      size_t m_cubic_offsets[bezier::cubic_batch::WIDTH];
+
+      void begin_segment();
+      void push_samples(size_t n_samples);
+      void flush_cubics();
+
+    public:
+      builder(std::vector<vertex>& vertices, const options& opts);
+
+      void operator()(const svg::action::move_to& move_to);
+      void operator()(const svg::action::line_to& line_to);
+      void operator()(const svg::action::quadratic_bezier_to& quad_to);
+      void operator()(const svg::action::cubic_bezier_to& cubic_to);
+      void operator()(const svg::action::elliptic_arc_to& arc_to);
+      void operator()(const svg::action::close_subpath&);
+
+      void finish();
+  }; /* class builder */
+} /* namespace flatten */
+
+#endif /* FLATTEN_HPP */
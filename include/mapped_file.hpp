@@ -0,0 +1,29 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <string>
+
+namespace input {
+  /*
+   * Read-only memory mapping of a whole file followed by at least one zero
+   * byte, so it can be handed to rapidxml's non-destructive parser without
+   * copying the file into a separate buffer first.
+   */
+  class mapped_file {
+    private:
+      char* m_data = nullptr;
+      size_t m_size = 0;
+      size_t m_mapped_size = 0;
+
+    public:
+      explicit mapped_file(const std::string& fpath);
+      mapped_file(const mapped_file&) = delete;
+      mapped_file& operator=(const mapped_file&) = delete;
+      ~mapped_file();
+
+      const char* data() const;
+      size_t size() const;
+  }; /* class mapped_file */
+} /* namespace input */
+
+#endif /* MAPPED_FILE_HPP */
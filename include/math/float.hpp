@@ -5,7 +5,6 @@
 #include <algorithm>
 
 #ifdef USE_DOUBLE_AS_FLOAT
-  #error Using double precision float is currently not supported.
   typedef double Float;
 #else
   typedef float Float;
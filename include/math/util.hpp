@@ -273,7 +273,7 @@ namespace math {
   }
 
   inline Float asin_clamp(Float x) {
-    return std::asin(math::clamp(x, -1.f, 1.f));
+    return std::asin(math::clamp<Float>(x, -1, 1));
   }
 
   inline Float mitchell(Float B, Float C, Float x) {
@@ -294,7 +294,7 @@ namespace math {
   }
 
   inline Float triangle_filter(Float x) {
-    return std::max(x >= 0.f ? 1.f - x : x + 1.f, 0.f);
+    return std::max<Float>(x >= 0.f ? 1.f - x : x + 1.f, 0);
   }
 
   inline Float blackman_harris_filter(Float x) {
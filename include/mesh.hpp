@@ -0,0 +1,75 @@
+#ifndef MESH_HPP
+#define MESH_HPP
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+#include "math/vector.hpp"
+
+namespace mesh {
+  using namespace math;
+
+  typedef std::array<uint32_t, 3> triangle;
+
+  /*
+   * Polygon with holes extruded along z. Point i stands for two vertices, i at
+   * z = 0 and i + points.size() at z = depth. Rings are oriented so that the
+   * solid lies to their left, and triangles wind counterclockwise seen from
+   * outside, covering the bottom, the top and the walls.
+   */
+  struct solid {
+    std::vector<vector2f> points;
+    std::vector<size_t> ring_ends;
+    std::vector<triangle> triangles;
+  };
+
+  typedef std::function<void(const solid&)> solid_sink;
+
+  /*
+   * Ear clipping triangulator. Rings are filled with the even-odd rule and
+   * every outer ring together with the holes directly inside it becomes one
+   * solid. Holes are bridged into their outer ring first, so each solid is
+   * clipped as a single polygon. Like fill::select_rings, this is exact as
+   * long as no rings cross; crossing rings still give closed solids, though
+   * not the right ones. Scratch buffers are reused between calls.
+   */
+  class triangulator {
+    private:
+      struct ring_info {
+        size_t first, last;
+        double area;
+        vector2f min, max;
+        size_t depth;
+        size_t parent;
+      };
+
+      std::vector<ring_info> m_rings;
+      std::vector<size_t> m_holes;
+      std::vector<uint32_t> m_polygon;
+      std::vector<uint32_t> m_prev, m_next;
+      std::vector<uint32_t> m_reflex;
+      std::vector<uint8_t> m_removed;
+      solid m_solid;
+
+      void classify(const vector2f* points);
+      void add_ring(const vector2f* points, const ring_info& ring, bool reverse);
+      bool bridge_hole(size_t first, size_t last);
+      void clip_ears();
+      void add_walls();
+
+    public:
+      /*
+       * Triangulate the rings [ring_ends[i - 1], ring_ends[i]) of points,
+       * ring_ends[-1] being 0, and hand every resulting solid to emit.
+       */
+      void operator()(
+          const vector2f* points,
+          const size_t* ring_ends,
+          size_t n_rings,
+          const solid_sink& emit);
+  }; /* class triangulator */
+} /* namespace mesh */
+
+#endif /* MESH_HPP */
@@ -0,0 +1,70 @@
+#ifndef MESH_WRITER_HPP
+#define MESH_WRITER_HPP
+
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+#include "mesh.hpp"
+#include "output.hpp"
+
+namespace mesh {
+  // writes the solids of one document, one at a time, in some file format
+  class exporter {
+    public:
+      virtual ~exporter() = default;
+
+      virtual void add(const solid& s) = 0;
+      // write whatever follows the last solid and flush
+      virtual void finish() = 0;
+  }; /* class exporter */
+
+  /*
+   * Binary STL. Since the triangle count belongs in the header, triangles are
+   * written as they come only if fd is the seekable file behind out, so that
+   * finish() can seek back to write it. Otherwise, as for pipes or fd -1,
+   * they are held in memory until finish().
+   */
+  class stl_exporter : public exporter {
+    private:
+      output::writer& m_out;
+      const int m_fd;
+      off_t m_start;
+      const Float m_depth;
+      uint64_t m_n_triangles = 0;
+      bool m_buffered = false;
+      std::string m_triangles; // records held back if m_buffered
+
+      void write_header();
+
+    public:
+      stl_exporter(output::writer& out, int fd, Float depth);
+
+      void add(const solid& s) override;
+      void finish() override;
+  }; /* class stl_exporter */
+
+  class zip_writer;
+
+  /*
+   * 3MF package holding one mesh object per solid, all grouped into a single
+   * build item. The package is an uncompressed zip written in one pass, so
+   * only the solid being added is ever held in memory.
+   */
+  class threemf_exporter : public exporter {
+    private:
+      std::unique_ptr<zip_writer> m_zip;
+      output::writer m_model;
+      const Float m_depth;
+      size_t m_n_objects = 0;
+
+    public:
+      threemf_exporter(output::writer& out, Float depth);
+      ~threemf_exporter();
+
+      void add(const solid& s) override;
+      void finish() override;
+  }; /* class threemf_exporter */
+} /* namespace mesh */
+
+#endif /* MESH_WRITER_HPP */
@@ -0,0 +1,74 @@
+#ifndef OUTPUT_HPP
+#define OUTPUT_HPP
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "math/float.hpp"
+
+namespace output {
+  static constexpr size_t FLOAT_BUFFER_SIZE = 32;
+
+  /*
+   * Format value in the style of printf's %g with the given number of
+   * significant digits, or with the fewest digits that read back to the same
+   * value if precision is 0. Always uses '.' regardless of locale. Returns the
+   * number of characters written to buf, which must hold FLOAT_BUFFER_SIZE.
+   */
+  size_t format_float(char* buf, Float value, int precision);
+
+  // receives a block of output each time a writer flushes
+  typedef std::function<void(const char* data, size_t n)> sink;
+
+  // sink writing everything to fd, throwing std::runtime_error on failure
+  sink fd_sink(int fd);
+
+  /*
+   * Buffered text writer. Text is collected in one reusable buffer and handed
+   * to the sink, write(2) on a file descriptor by default, only when the
+   * buffer fills up or on flush().
+   */
+  class writer {
+    private:
+      int m_fd = -1;
+      bool m_owns_fd = false;
+      sink m_sink;
+      std::vector<char> m_buffer;
+      size_t m_size = 0;
+      int m_precision;
+
+    public:
+      static constexpr size_t DEFAULT_CAPACITY = 1 << 20;
+
+      explicit writer(
+          const sink& output_sink,
+          int precision = 6,
+          size_t capacity = DEFAULT_CAPACITY);
+      explicit writer(int fd, int precision = 6, size_t capacity = DEFAULT_CAPACITY);
+      explicit writer(
+          const std::string& fpath,
+          int precision = 6,
+          size_t capacity = DEFAULT_CAPACITY);
+      writer(const writer&) = delete;
+      writer& operator=(const writer&) = delete;
+      ~writer();
+
+      void write(const char* data, size_t n);
+      void flush();
+      // flush to the current sink, then send further output to output_sink
+      void redirect(const sink& output_sink);
+      // drop buffered output that has not reached the sink yet
+      void discard();
+      int precision() const;
+      // file descriptor written by the default sink, or -1
+      int fd() const;
+
+      writer& operator<<(char c);
+      writer& operator<<(const char* str);
+      writer& operator<<(const std::string& str);
+      writer& operator<<(Float value);
+  }; /* class writer */
+} /* namespace output */
+
+#endif /* OUTPUT_HPP */
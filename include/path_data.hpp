@@ -0,0 +1,29 @@
+#ifndef PATH_DATA_HPP
+#define PATH_DATA_HPP
+
+#include <svgpp/parser/external_function/parse_path_data.hpp>
+
+namespace path_data {
+  template <typename Coordinate>
+    using events = svgpp::detail::path_events_interface<Coordinate>;
+
+  /*
+   * Parse the path data in [it, end) into events, accepting exactly what
+   * svgpp's Spirit path_data_grammar accepts and emitting the same events,
+   * though numbers may differ from Spirit's in the last bit. With
+   * SVGPP_USE_EXTERNAL_PATH_DATA_PARSER svgpp calls this for every d
+   * attribute. Parsing stops at the first command that is malformed, after the events
+   * of everything before it have been sent, leaving it short of end.
+   * path_exit() is always sent last. Instantiated for float and double.
+   */
+  template <typename Coordinate>
+    bool parse(const char*& it, const char* end, events<Coordinate>& context);
+
+  /*
+   * Parse one number at it in SVG syntax, without a sign if not signed, and
+   * advance it past it. Returns false, leaving it alone, if there is none.
+   */
+  bool parse_number(const char*& it, const char* end, double& value, bool signed_number = true);
+} /* namespace path_data */
+
+#endif /* PATH_DATA_HPP */
@@ -257,6 +257,15 @@ namespace rapidxml_ns
     //! See xml_document::parse() function.
     const int parse_no_namespace = 0x1000;
 
+    //! Parse flag instructing the parser to translate entities and normalize whitespace in copies of the strings that need it,
+    //! allocated from the memory pool of the document, instead of in the source text.
+    //! Combined with rapidxml_ns::parse_no_string_terminators, the source text is never modified,
+    //! while values read the same as with default flags.
+    //! Can be combined with other flags by use of | operator.
+    //! <br><br>
+    //! See xml_document::parse() function.
+    const int parse_translate_in_pool = 0x2000;
+
     // Compound flags
     
     //! Parse flags which represent default behaviour of the parser. 
@@ -1762,10 +1771,26 @@ namespace rapidxml_ns
     
     public:
 
+        //! Predicate telling whether the contents of an element are to be skipped.
+        //! It is called with the element once its name, attributes and namespace are known.
+        typedef bool (*skip_contents_predicate)(const xml_node<Ch> *element);
+
         //! Constructs empty XML document
         xml_document()
             : xml_node<Ch>(node_document)
+            , m_skip_contents(0)
+        {
+        }
+
+        //! Sets predicate selecting elements whose contents are skipped by subsequent parses.
+        //! Such elements keep their name and attributes but get no child nodes; their contents
+        //! are only scanned for the matching closing tag, taking comments, CDATA sections,
+        //! processing instructions and quoted attribute values into account.
+        //! Closing tags inside skipped contents are not validated.
+        //! \param skip_contents Predicate, or 0 to parse all contents.
+        void set_skip_contents(skip_contents_predicate skip_contents)
         {
+            m_skip_contents = skip_contents;
         }
 
         //! Parses zero-terminated XML string according to given flags.
@@ -1788,6 +1813,22 @@ namespace rapidxml_ns
                 parse_ns<Flags, internal::xml_namespace_processor<Ch> >(text);
         }
 
+        //! Parses zero-terminated XML string according to given flags, without modifying it.
+        //! Flags must include rapidxml_ns::parse_no_string_terminators, and either rapidxml_ns::parse_translate_in_pool
+        //! or rapidxml_ns::parse_no_entity_translation without whitespace trimming and normalization.
+        //! The string must persist for the lifetime of the document.
+        //! \param text XML data to parse, which may be read-only memory.
+        template<int Flags>
+        void parse(const Ch *text)
+        {
+            static_assert((Flags & parse_no_string_terminators) &&
+                          ((Flags & parse_translate_in_pool) ||
+                           ((Flags & parse_no_entity_translation) &&
+                            !(Flags & (parse_trim_whitespace | parse_normalize_whitespace)))),
+                          "flags must not allow the parser to modify the source text");
+            parse<Flags>(const_cast<Ch *>(text));
+        }
+
         //! Use parse() instead. 
         //! Parses zero-terminated XML string according to given flags and NamespaceProcessor passed.
         //! Should be called only when default xml_namespace_processor is substituted with custom one.
@@ -1839,6 +1880,8 @@ namespace rapidxml_ns
         
     private:
 
+        skip_contents_predicate m_skip_contents;
+
         ///////////////////////////////////////////////////////////////////////
         // Internal character utility functions
         
@@ -2153,6 +2196,32 @@ namespace rapidxml_ns
 
         }
 
+        // Skip characters as skip_and_expand_character_refs() does, starting at value.
+        // With parse_translate_in_pool, characters needing translation are translated in a copy
+        // from the memory pool instead, and value is moved to the copy.
+        template<class StopPred, class StopPredPure, int Flags>
+        Ch *skip_and_translate(Ch *&text, Ch *&value)
+        {
+            if (!(Flags & parse_translate_in_pool) ||
+                (Flags & parse_no_entity_translation &&
+                 !(Flags & parse_normalize_whitespace) &&
+                 !(Flags & parse_trim_whitespace)))
+                return skip_and_expand_character_refs<StopPred, StopPredPure, Flags>(text);
+
+            // Nothing to translate
+            skip<StopPredPure, Flags>(text);
+            if (!StopPred::test(*text))
+                return text;
+
+            // Copy up to and including the character that stops translation, then translate the copy
+            Ch *translated = text;
+            skip<StopPred, Flags>(text);
+            Ch *copy = this->allocate_string(value, text - value + 1);
+            Ch *src = copy + (translated - value);
+            value = copy;
+            return skip_and_expand_character_refs<StopPred, StopPredPure, Flags & ~parse_translate_in_pool>(src);
+        }
+
         ///////////////////////////////////////////////////////////////////////
         // Internal parsing functions
         
@@ -2382,9 +2451,9 @@ namespace rapidxml_ns
             // Skip until end of data
             Ch *value = text, *end;
             if (Flags & parse_normalize_whitespace)
-                end = skip_and_expand_character_refs<text_pred, text_pure_with_ws_pred, Flags>(text);   
+                end = skip_and_translate<text_pred, text_pure_with_ws_pred, Flags>(text, value);
             else
-                end = skip_and_expand_character_refs<text_pred, text_pure_no_ws_pred, Flags>(text);
+                end = skip_and_translate<text_pred, text_pure_no_ws_pred, Flags>(text, value);
 
             // Trim trailing whitespace if flag is set; leading was already trimmed by whitespace skip after >
             if (Flags & parse_trim_whitespace)
@@ -2512,7 +2581,10 @@ namespace rapidxml_ns
             if (*text == Ch('>'))
             {
                 ++text;
-                parse_node_contents<Flags, NamespaceScope>(text, element, namespace_scope);
+                if (m_skip_contents && m_skip_contents(element))
+                    skip_node_contents(text);
+                else
+                    parse_node_contents<Flags, NamespaceScope>(text, element, namespace_scope);
             }
             else if (*text == Ch('/'))
             {
@@ -2618,6 +2690,85 @@ namespace rapidxml_ns
             }
         }
 
+        // Advance text to after terminator, which must follow before end of data
+        static void skip_past(Ch *&text, const Ch *terminator)
+        {
+            while (1)
+            {
+                if (*text == 0)
+                    RAPIDXML_PARSE_ERROR("unexpected end of data", text);
+                const Ch *t = terminator, *p = text;
+                while (*t && *p == *t)
+                    ++t, ++p;
+                if (*t == 0)
+                {
+                    text = const_cast<Ch *>(p);
+                    return;
+                }
+                ++text;
+            }
+        }
+
+        // Skip contents of the node up to and including its closing tag, without creating nodes
+        static void skip_node_contents(Ch *&text)
+        {
+            static const Ch comment_end[] = { Ch('-'), Ch('-'), Ch('>'), 0 };
+            static const Ch cdata_end[] = { Ch(']'), Ch(']'), Ch('>'), 0 };
+            static const Ch pi_end[] = { Ch('?'), Ch('>'), 0 };
+            static const Ch tag_end[] = { Ch('>'), 0 };
+            std::size_t depth = 0;
+            while (1)
+            {
+                // Find next markup
+                while (*text != Ch('<'))
+                {
+                    if (*text == 0)
+                        RAPIDXML_PARSE_ERROR("unexpected end of data", text);
+                    ++text;
+                }
+                if (text[1] == Ch('/'))
+                {
+                    // Closing tag
+                    skip_past(text, tag_end);
+                    if (depth-- == 0)
+                        return;
+                }
+                else if (text[1] == Ch('!'))
+                {
+                    if (text[2] == Ch('-') && text[3] == Ch('-'))
+                        skip_past(text += 4, comment_end);
+                    else if (text[2] == Ch('[') && text[3] == Ch('C') && text[4] == Ch('D') &&
+                             text[5] == Ch('A') && text[6] == Ch('T') && text[7] == Ch('A') &&
+                             text[8] == Ch('['))
+                        skip_past(text += 9, cdata_end);
+                    else
+                        skip_past(text, tag_end);
+                }
+                else if (text[1] == Ch('?'))
+                    skip_past(text += 2, pi_end);
+                else
+                {
+                    // Opening or empty element tag, possibly with '>' in quoted attribute values
+                    Ch quote = 0;
+                    for (++text; quote || *text != Ch('>'); ++text)
+                    {
+                        if (*text == 0)
+                            RAPIDXML_PARSE_ERROR("unexpected end of data", text);
+                        if (quote)
+                        {
+                            if (*text == quote)
+                                quote = 0;
+                        }
+                        else if (*text == Ch('"') || *text == Ch('\''))
+                            quote = *text;
+                    }
+                    if (text[-1] != Ch('/'))
+                        ++depth;
+                    ++text;
+                }
+            }
+        }
+
         // Parse contents of the node - children, data etc.
         template<int Flags, class NamespaceScope>
         void parse_node_contents(Ch *&text, xml_node<Ch> *node, NamespaceScope const & namespace_scope)
@@ -2748,9 +2899,9 @@ namespace rapidxml_ns
                 Ch *value = text, *end;
                 const int AttFlags = Flags & ~parse_normalize_whitespace;   // No whitespace normalization in attributes
                 if (quote == Ch('\''))
-                    end = skip_and_expand_character_refs<attribute_value_pred<Ch('\'')>, attribute_value_pure_pred<Ch('\'')>, AttFlags>(text);
+                    end = skip_and_translate<attribute_value_pred<Ch('\'')>, attribute_value_pure_pred<Ch('\'')>, AttFlags>(text, value);
                 else
-                    end = skip_and_expand_character_refs<attribute_value_pred<Ch('"')>, attribute_value_pure_pred<Ch('"')>, AttFlags>(text);
+                    end = skip_and_translate<attribute_value_pred<Ch('"')>, attribute_value_pure_pred<Ch('"')>, AttFlags>(text, value);
                 
                 // Set attribute value
                 attribute->value(value, end - value);
@@ -0,0 +1,35 @@
+#ifndef SIMPLIFY_HPP
+#define SIMPLIFY_HPP
+
+#include <vector>
+#include <utility>
+
+#include "flatten.hpp"
+
+namespace simplify {
+  using namespace math;
+
+  /*
+   * Ramer-Douglas-Peucker simplification of every subpath of flattened
+   * vertices. Removed vertices lie within tolerance of the polyline through
+   * the kept ones; the first and last vertex of each subpath are always kept.
+   * Recursion is replaced by an explicit stack and the scratch buffers are
+   * reused between calls, so keep one simplifier per thread.
+   */
+  class simplifier {
+    private:
+      std::vector<uint8_t> m_keep;
+      std::vector<std::pair<size_t, size_t>> m_stack;
+
+      void mark(
+          const std::vector<flatten::vertex>& vertices,
+          size_t first,
+          size_t last,
+          double tolerance_squared);
+
+    public:
+      void operator()(std::vector<flatten::vertex>& vertices, Float tolerance);
+  }; /* class simplifier */
+} /* namespace simplify */
+
+#endif /* SIMPLIFY_HPP */
@@ -0,0 +1,80 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdint>
+
+#include "svg_path.hpp"
+#include "output.hpp"
+
+namespace stats {
+  enum stage {
+    STAGE_PARSE,        // XML parsing
+    STAGE_TRAVERSE,     // svgpp traversal into paths
+    STAGE_FLATTEN,      // curves to vertices, including --simplify
+    STAGE_TRIANGULATE,  // STL and 3MF only
+    STAGE_FORMAT,       // everything else between reading and writing
+    STAGE_WRITE,        // handing output to the file
+    N_STAGES
+  };
+
+  typedef std::chrono::steady_clock clock;
+
+  /*
+   * Counters of a whole run, shared by all threads. Stage times are summed
+   * over threads, so with --jobs they may add up to more than the wall time.
+   */
+  class counters {
+    private:
+      const clock::time_point m_start;
+      std::atomic<uint64_t> m_nanoseconds[N_STAGES];
+      std::atomic<uint64_t> m_commands[svg::action::ACTION_UNKNOWN];
+      std::atomic<uint64_t> m_vertices;
+      std::atomic<uint64_t> m_bytes_written;
+      std::mutex m_elements_mutex;
+      std::map<std::string, uint64_t> m_elements;
+
+    public:
+      counters();
+
+      void add_time(stage s, clock::duration elapsed);
+      void add_elements(const std::map<std::string, uint64_t>& elements);
+      void add_commands(const svg::path& path);
+      void add_vertices(size_t n);
+      void add_bytes_written(size_t n);
+
+      void print(output::writer& out);
+      void print_json(output::writer& out);
+  }; /* class counters */
+
+  /*
+   * Charges the time until its destruction to one stage of c, if c is not
+   * null. A scope opened inside another one on the same thread pauses the
+   * outer one, so every moment is charged to exactly one stage.
+   */
+  class scope {
+    private:
+      counters* const m_counters;
+      const stage m_stage;
+      clock::time_point m_start;
+      scope* m_outer;
+
+    public:
+      scope(counters* c, stage s);
+      scope(const scope&) = delete;
+      scope& operator=(const scope&) = delete;
+      ~scope();
+  }; /* class scope */
+
+  // sink passing everything on to s, charging it to STAGE_WRITE of c
+  output::sink counted_sink(const output::sink& s, counters& c);
+
+  // largest resident set size of the process so far, in bytes
+  uint64_t peak_rss();
+} /* namespace stats */
+
+#endif /* STATS_HPP */
@@ -0,0 +1,38 @@
+#ifndef STROKE_HPP
+#define STROKE_HPP
+
+#include <vector>
+
+#include "flatten.hpp"
+#include "svg_path.hpp"
+
+namespace stroke {
+  using namespace math;
+
+  struct options {
+    Float width = 1;
+    svg::style::line_join_type line_join = svg::style::LINE_JOIN_MITER;
+    svg::style::line_cap_type line_cap = svg::style::LINE_CAP_BUTT;
+    Float miter_limit = 4;
+    // decides how finely round joins and caps are approximated
+    flatten::options flatten;
+
+    options() = default;
+    options(const svg::style& paint, const flatten::options& flatten_options);
+  };
+
+  /*
+   * Outline the stroke of every subpath in vertices. The outline is appended
+   * as a list of simple polygons, piece i spanning points
+   * [piece_ends[i - 1], piece_ends[i]), whose union is the stroke: one per
+   * segment together with the join at its end, and the caps of open subpaths.
+   * Pieces overlap, so they must not be filled as one even-odd polygon.
+   */
+  void outline(
+      const std::vector<flatten::vertex>& vertices,
+      const options& opts,
+      std::vector<vector2f>& points,
+      std::vector<size_t>& piece_ends);
+} /* namespace stroke */
+
+#endif /* STROKE_HPP */
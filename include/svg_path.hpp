@@ -0,0 +1,244 @@
+#ifndef SVG_PATH_HPP
+#define SVG_PATH_HPP
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+#include "math/vector.hpp"
+
+namespace svg {
+
+  using namespace math;
+
+  namespace action {
+    enum type : uint8_t {
+      ACTION_MOVE_TO,
+      ACTION_LINE_TO,
+      ACTION_QUAD_BEZIER_TO,
+      ACTION_CUBIC_BEZIER_TO,
+      ACTION_ELLIPTIC_ARC_TO,
+      ACTION_CLOSE_SUBPATH,
+      ACTION_UNKNOWN
+    };
+
+    // opcode layout: low bits hold the action type, high bits hold arc flags
+    enum opcode_bits : uint8_t {
+      OPCODE_TYPE_MASK  = 0x3f,
+      OPCODE_LARGE_ARC  = 0x40,
+      OPCODE_SWEEP      = 0x80
+    };
+
+    struct move_to {
+      union { vector2f p1, dst; };
+
+      move_to() = delete;
+      move_to(const vector2f& _p1) : p1(_p1) {}
+    };
+
+    struct line_to {
+      union { vector2f p1, dst; };
+
+      line_to() = delete;
+      line_to(const vector2f& _p1) : p1(_p1) {}
+    };
+
+    struct quadratic_bezier_to {
+      vector2f p1;
+      union { vector2f p2, dst; };
+
+      quadratic_bezier_to() = delete;
+      quadratic_bezier_to(const vector2f& _p1, const vector2f& _p2) : p1(_p1), p2(_p2) {}
+    };
+
+    struct cubic_bezier_to {
+      vector2f p1, p2;
+      union { vector2f p3, dst; };
+
+      cubic_bezier_to() = delete;
+      cubic_bezier_to(const vector2f& _p1, const vector2f& _p2, const vector2f& _p3)
+        : p1(_p1), p2(_p2), p3(_p3) {}
+    };
+
+    struct elliptic_arc_to {
+      vector2f r;
+      Float x_axis_rotation;
+      union { vector2f p1, dst; };
+      bool large_arc;
+      bool sweep;
+
+      elliptic_arc_to() = delete;
+      elliptic_arc_to(
+          const vector2f& _r,
+          Float _x_axis_rotation,
+          const vector2f& _p1,
+          bool _large_arc,
+          bool _sweep)
+        : r(_r), x_axis_rotation(_x_axis_rotation), p1(_p1), large_arc(_large_arc), sweep(_sweep) {}
+    };
+
+    struct close_subpath {};
+
+    // number of coordinates an action of the given type takes in the coordinate stream
+    inline size_t n_coords(uint8_t opcode) {
+      switch (opcode & OPCODE_TYPE_MASK) {
+        case ACTION_MOVE_TO:          return 2;
+        case ACTION_LINE_TO:          return 2;
+        case ACTION_QUAD_BEZIER_TO:   return 4;
+        case ACTION_CUBIC_BEZIER_TO:  return 6;
+        case ACTION_ELLIPTIC_ARC_TO:  return 5;
+        default:                      return 0;
+      }
+    }
+  } /* namespace action */
+
+  // presentation attributes of a shape that decide what geometry it produces
+  struct style {
+    enum fill_rule_type : uint8_t {
+      FILL_RULE_NONZERO,
+      FILL_RULE_EVENODD
+    };
+
+    enum line_join_type : uint8_t {
+      LINE_JOIN_MITER,
+      LINE_JOIN_ROUND,
+      LINE_JOIN_BEVEL
+    };
+
+    enum line_cap_type : uint8_t {
+      LINE_CAP_BUTT,
+      LINE_CAP_ROUND,
+      LINE_CAP_SQUARE
+    };
+
+    bool filled = true;
+    fill_rule_type fill_rule = FILL_RULE_NONZERO;
+    bool stroked = false;
+    line_join_type line_join = LINE_JOIN_MITER;
+    line_cap_type line_cap = LINE_CAP_BUTT;
+    Float stroke_width = 1;
+    Float miter_limit = 4;
+
+    bool operator==(const style& rhs) const;
+  };
+
+  /*
+   * Contiguous path buffer: one opcode byte per command plus a flat coordinate
+   * stream. Commands are replayed through visit() which calls the visitor's
+   * operator() with the matching action record built on the stack.
+   */
+  class path {
+    private:
+      std::vector<uint8_t> m_opcodes;
+      std::vector<Float> m_coords;
+
+    public:
+      // run of commands [first, last) whose coordinates start at coord_offset
+      struct range {
+        size_t first;
+        size_t last;
+        size_t coord_offset;
+      };
+
+      // commands from first up to the next shape's first belong to one SVG element
+      struct shape {
+        size_t first;
+        size_t coord_offset;
+        style paint;
+      };
+
+      // a <use> placing a definition, transformed by SVG's matrix(a b c d e f)
+      struct instance {
+        size_t definition;
+        std::array<Float, 6> transform;
+      };
+
+    private:
+      std::vector<shape> m_shapes;
+      std::vector<instance> m_instances;
+
+    public:
+      // following commands belong to a new shape painted with the given style
+      void begin_shape(const style& paint);
+
+      void move_to(const vector2f& dst);
+      void line_to(const vector2f& dst);
+      void quadratic_bezier_to(const vector2f& p1, const vector2f& p2);
+      void cubic_bezier_to(const vector2f& p1, const vector2f& p2, const vector2f& p3);
+      void elliptic_arc_to(
+          const vector2f& r,
+          Float x_axis_rotation,
+          const vector2f& dst,
+          bool large_arc,
+          bool sweep);
+      void close_subpath();
+      void add_instance(size_t definition, const std::array<Float, 6>& transform);
+
+      void reserve(size_t n_commands, size_t n_coords);
+      void clear();
+
+      size_t size() const;
+      bool empty() const;
+      const std::vector<uint8_t>& opcodes() const;
+      const std::vector<Float>& coords() const;
+      const std::vector<shape>& shapes() const;
+      const std::vector<instance>& instances() const;
+      // commands of the i-th shape
+      range shape_commands(size_t i) const;
+
+      /*
+       * Split the commands into at most n_parts ranges of similar length. Ranges
+       * only start at move_to commands so each one holds whole subpaths, and
+       * with whole_shapes only where a shape begins.
+       */
+      std::vector<range> split(size_t n_parts, bool whole_shapes = false) const;
+
+      template <typename Visitor>
+        void visit(Visitor&& visitor) const {
+          visit(visitor, { 0, m_opcodes.size(), 0 });
+        }
+
+      template <typename Visitor>
+        void visit(Visitor&& visitor, const range& commands) const {
+          const Float* c = m_coords.data() + commands.coord_offset;
+          for (size_t i = commands.first; i < commands.last; ++i) {
+            const uint8_t opcode = m_opcodes[i];
+            switch (opcode & action::OPCODE_TYPE_MASK) {
+              case action::ACTION_MOVE_TO:
+                visitor(action::move_to({ c[0], c[1] }));
+                c += 2;
+                break;
+              case action::ACTION_LINE_TO:
+                visitor(action::line_to({ c[0], c[1] }));
+                c += 2;
+                break;
+              case action::ACTION_QUAD_BEZIER_TO:
+                visitor(action::quadratic_bezier_to({ c[0], c[1] }, { c[2], c[3] }));
+                c += 4;
+                break;
+              case action::ACTION_CUBIC_BEZIER_TO:
+                visitor(action::cubic_bezier_to({ c[0], c[1] }, { c[2], c[3] }, { c[4], c[5] }));
+                c += 6;
+                break;
+              case action::ACTION_ELLIPTIC_ARC_TO:
+                visitor(action::elliptic_arc_to(
+                      { c[0], c[1] },
+                      c[2],
+                      { c[3], c[4] },
+                      opcode & action::OPCODE_LARGE_ARC,
+                      opcode & action::OPCODE_SWEEP
+                      ));
+                c += 5;
+                break;
+              case action::ACTION_CLOSE_SUBPATH:
+                visitor(action::close_subpath());
+                break;
+              default:
+                ASSERT(false, "unknown SVG action in path buffer");
+            }
+          }
+        }
+  }; /* class path */
+} /* namespace svg */
+
+#endif /* SVG_PATH_HPP */
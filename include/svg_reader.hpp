@@ -1,144 +1,274 @@
 #ifndef SVG_READER_HPP
 #define SVG_READER_HPP
 
+#include <deque>
 #include <string>
-#include <memory>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "svgpp/svgpp.hpp"
-#include "rapidxml_ns/rapidxml_ns_utils.hpp"
+#include "rapidxml_ns/rapidxml_ns.hpp"
 #include "svgpp/policy/xml/rapidxml_ns.hpp"
 #include "math/util.hpp"
+#include "math/matrix.hpp"
+#include "svg_path.hpp"
+#include "stats.hpp"
 
 namespace svg {
 
   using namespace math;
 
-  namespace action {
-    enum type {
-      ACTION_MOVE_TO,
-      ACTION_LINE_TO,
-      ACTION_QUAD_BEZIER_TO,
-      ACTION_CUBIC_BEZIER_TO,
-      ACTION_ELLIPTIC_ARC_TO,
-      ACTION_UNKNOWN
-    };
-
-    struct base {
-      virtual ~base() {}
-    };
-
-    struct move_to : base {
-      union { vector2f p1, dst; };
-
-      move_to() = delete;
-      move_to(const vector2f& _p1) : p1(_p1) {}
-    };
-
-    struct line_to : base {
-      union { vector2f p1, dst; };
+  /*
+   * Whether the reader leaves the contents of element unparsed: foreign
+   * markup such as editor metadata, and SVG elements whose contents are
+   * neither drawn nor reachable through <use>.
+   */
+  bool skips_contents(const rapidxml_ns::xml_node<>* element);
 
-      line_to() = delete;
-      line_to(const vector2f& _p1) : p1(_p1) {}
-    };
-
-    struct quadratic_bezier_to : base {
-      vector2f p1;
-      union { vector2f p2, dst; };
-
-      quadratic_bezier_to() = delete;
-      quadratic_bezier_to(const vector2f& _p1, const vector2f& _p2) : p1(_p1), p2(_p2) {}
-    };
-
-    struct cubic_bezier_to : base {
-      vector2f p1, p2;
-      union { vector2f p3, dst; };
-
-      cubic_bezier_to() = delete;
-      cubic_bezier_to(const vector2f& _p1, const vector2f& _p2, const vector2f& _p3)
-        : p1(_p1), p2(_p2), p3(_p3) {}
-    };
-
-    struct elliptic_arc_to : base {
-      vector2f r;
-      float x_axis_rotation;
-      union { vector2f p1, dst; }; 
-      bool large_arc;
-      bool sweep;
-
-      elliptic_arc_to() = delete;
-      elliptic_arc_to(
-          const vector2f& _r,
-          float _x_axis_rotation,
-          const vector2f& _p1,
-          bool _large_arc,
-          bool _sweep)
-        : r(_r), x_axis_rotation(_x_axis_rotation), p1(_p1), large_arc(_large_arc), sweep(_sweep) {}
-    };
-
-    inline type get_type(const std::shared_ptr<base>& action) {
-      base* base_ptr = action.get();
-      if (dynamic_cast<move_to*>(base_ptr))             return ACTION_MOVE_TO;
-      if (dynamic_cast<line_to*>(base_ptr))             return ACTION_LINE_TO;
-      if (dynamic_cast<quadratic_bezier_to*>(base_ptr)) return ACTION_QUAD_BEZIER_TO;
-      if (dynamic_cast<cubic_bezier_to*>(base_ptr))     return ACTION_CUBIC_BEZIER_TO;
-      if (dynamic_cast<elliptic_arc_to*>(base_ptr))     return ACTION_ELLIPTIC_ARC_TO;
-      return ACTION_UNKNOWN;
-    }
-  } /* namespace action */
+  /*
+   * rapidxml flags the reader parses with. The document text is left as it
+   * is, so it may be read-only; names and values are not null terminated,
+   * and only values with entity references are copied to be translated.
+   */
+  constexpr int PARSE_FLAGS =
+    rapidxml_ns::parse_no_string_terminators | rapidxml_ns::parse_translate_in_pool;
 
   class reader {
+    public:
+      static constexpr size_t NO_DEFINITION = static_cast<size_t>(-1);
+
     private:
       class context {
         private:
-          std::vector<std::shared_ptr<action::base>> m_actions;
+          // inherited state of an open element
+          struct element_state {
+            matrix3f transform; // user space to output coordinates
+            style paint;
+            bool is_use = false;
+          };
+
+          reader& m_reader;
+          path m_path;
+          path* m_target; // m_path, or a definition being loaded
+          std::vector<element_state> m_states; // innermost element last
+          bool m_in_shape = false;
+          // attributes of the innermost <use>
+          std::string m_href;
+          vector2f m_use_offset;
+
+          // what begin_definition interrupted
+          struct saved_state {
+            path* target;
+            std::vector<element_state> states;
+            bool in_shape;
+          };
+          std::vector<saved_state> m_saved;
+
+          vector2f transform_point(Float x, Float y) const;
+          void begin_command();
 
         public:
-          context() = default;
+          explicit context(reader& owner);
           ~context();
 
-          const std::vector<std::shared_ptr<action::base>>& actions() const;
+          const path& actions() const;
+          void clear();
+          // send path events to definition in its own user space, inheriting paint
+          void begin_definition(path& definition, const style& paint);
+          void end_definition();
 
           // SVG events
-          void path_move_to(float x, float y, svgpp::tag::coordinate::absolute);
-          void path_line_to(float x, float y, svgpp::tag::coordinate::absolute);
+          void path_move_to(Float x, Float y, svgpp::tag::coordinate::absolute);
+          void path_line_to(Float x, Float y, svgpp::tag::coordinate::absolute);
           void path_quadratic_bezier_to(
-              float x1, float y1,
-              float x, float y,
+              Float x1, Float y1,
+              Float x, Float y,
               svgpp::tag::coordinate::absolute);
           void path_cubic_bezier_to(
-              float x1, float y1,
-              float x2, float y2,
-              float x, float y,
+              Float x1, Float y1,
+              Float x2, Float y2,
+              Float x, Float y,
               svgpp::tag::coordinate::absolute);
           void path_elliptical_arc_to(
-              float rx, float ry, float x_axis_rotation,
+              Float rx, Float ry, Float x_axis_rotation,
               bool large_arc_flag, bool sweep_flag,
-              float x, float y,
+              Float x, Float y,
               svgpp::tag::coordinate::absolute);
           void path_close_subpath();
           void path_exit();
+          void transform_matrix(const boost::array<Float, 6>& matrix);
+
+          // paint events; any fill or stroke other than none counts as painted
+          void set(svgpp::tag::attribute::fill, svgpp::tag::value::none);
+          void set(svgpp::tag::attribute::fill, svgpp::tag::value::inherit);
+          template <typename... Args>
+            void set(svgpp::tag::attribute::fill, const Args&...) {
+              m_states.back().paint.filled = true;
+            }
+          void set(svgpp::tag::attribute::fill_rule, svgpp::tag::value::nonzero);
+          void set(svgpp::tag::attribute::fill_rule, svgpp::tag::value::evenodd);
+          void set(svgpp::tag::attribute::fill_rule, svgpp::tag::value::inherit);
+          void set(svgpp::tag::attribute::stroke, svgpp::tag::value::none);
+          void set(svgpp::tag::attribute::stroke, svgpp::tag::value::inherit);
+          template <typename... Args>
+            void set(svgpp::tag::attribute::stroke, const Args&...) {
+              m_states.back().paint.stroked = true;
+            }
+          void set(svgpp::tag::attribute::stroke_width, Float width);
+          void set(svgpp::tag::attribute::stroke_width, svgpp::tag::value::inherit);
+          void set(svgpp::tag::attribute::stroke_linejoin, svgpp::tag::value::miter);
+          void set(svgpp::tag::attribute::stroke_linejoin, svgpp::tag::value::round);
+          void set(svgpp::tag::attribute::stroke_linejoin, svgpp::tag::value::bevel);
+          void set(svgpp::tag::attribute::stroke_linejoin, svgpp::tag::value::inherit);
+          void set(svgpp::tag::attribute::stroke_linecap, svgpp::tag::value::butt);
+          void set(svgpp::tag::attribute::stroke_linecap, svgpp::tag::value::round);
+          void set(svgpp::tag::attribute::stroke_linecap, svgpp::tag::value::square);
+          void set(svgpp::tag::attribute::stroke_linecap, svgpp::tag::value::inherit);
+          void set(svgpp::tag::attribute::stroke_miterlimit, Float limit);
+          void set(svgpp::tag::attribute::stroke_miterlimit, svgpp::tag::value::inherit);
+
+          // <use> events; only references within the document are followed
+          template <typename IRI>
+            void set(
+                svgpp::tag::attribute::xlink::href,
+                svgpp::tag::iri_fragment,
+                const IRI& fragment)
+            {
+              m_href.assign(boost::begin(fragment), boost::end(fragment));
+            }
+          template <typename IRI>
+            void set(svgpp::tag::attribute::xlink::href, const IRI&) {}
+          void set(svgpp::tag::attribute::x, Float x);
+          void set(svgpp::tag::attribute::y, Float y);
 
           // XML events
           void on_enter_element(svgpp::tag::element::any);
+          void on_enter_element(svgpp::tag::element::use_);
           void on_exit_element();
 
           static const bool convert_only_rounded_rect_to_path = false;
       } m_context;
 
-      float m_width   = 0.0f;
-      float m_height  = 0.0f;
+      // kept across loads so its memory pool is reused
+      rapidxml_ns::xml_document<> m_document;
+
+      // elements referenced by <use>, each loaded once per inherited paint
+      std::deque<path> m_definitions;
+      std::vector<style> m_definition_paints;
+      std::unordered_multimap<std::string, size_t> m_definition_ids;
+      std::vector<std::string> m_loading; // ids being loaded, to stop reference cycles
+      std::unordered_set<std::string> m_missing_ids; // already warned about
+      // elements of m_document by id, built on the first reference
+      std::unordered_map<std::string, rapidxml_ns::xml_node<>*> m_elements_by_id;
+      bool m_indexed = false;
+
+      // null terminated copy of a document given to load_buffer() without one
+      std::vector<char> m_text;
+
+      Float m_width   = 0;
+      Float m_height  = 0;
+
+      stats::counters* m_stats = nullptr;
+
+      void load_root(rapidxml_ns::xml_node<>* svg_element, bool read_size);
+      void parse_document(const char* text);
+      // count elements below root into m_stats, skipping its first n_repeated children
+      void count_elements(rapidxml_ns::xml_node<>* root, size_t n_repeated, bool count_root);
+      void clear_definitions();
+      // index of the definition for the element with the given id, or NO_DEFINITION
+      size_t load_definition(const std::string& id, const style& paint);
 
     public:
+      typedef std::function<void(const path&)> chunk_handler;
+      static constexpr size_t DEFAULT_CHUNK_SIZE = 1 << 20;
+
       reader();
       reader(const std::string& fpath);
       ~reader();
 
-      const std::vector<std::shared_ptr<action::base>>& actions() const;
-      const std::vector<std::shared_ptr<action::base>>& load_file(const std::string& fpath);
-      float width() const;
-      float height() const;
+      const path& actions() const;
+      // report parse and traversal times and element counts to counters, if not null
+      void set_stats(stats::counters* counters);
+      /*
+       * Paths of the elements referenced by <use>, in their own user space and
+       * indexed by path::instance::definition. They may place further
+       * definitions themselves. Definitions of a streamed document accumulate
+       * over all chunks.
+       */
+      const std::deque<path>& definitions() const;
+      const path& load_file(const std::string& fpath);
+      /*
+       * Load the document in [data, data + size), which need not be null
+       * terminated. It is parsed where it is if its last byte is a null
+       * character, and copied first otherwise.
+       */
+      const path& load_buffer(const char* data, size_t size);
+
+      /*
+       * Read the document in chunks of consecutive top-level elements of about
+       * chunk_size bytes. Only one chunk's DOM and path buffer exist at a time;
+       * handler is called with the path of each chunk in document order.
+       */
+      void stream_file(
+          const std::string& fpath,
+          const chunk_handler& handler,
+          size_t chunk_size = DEFAULT_CHUNK_SIZE);
+      void stream_buffer(
+          const char* data,
+          size_t size,
+          const chunk_handler& handler,
+          size_t chunk_size = DEFAULT_CHUNK_SIZE);
+      Float width() const;
+      Float height() const;
   }; /* class reader */
 
+  using processed_attribute_t = boost::mpl::fold<
+    boost::mpl::protect<
+      boost::mpl::joint_view<
+        svgpp::traits::shapes_attributes_by_element,
+        boost::mpl::vector<
+          svgpp::tag::attribute::transform,
+          svgpp::tag::attribute::fill,
+          svgpp::tag::attribute::fill_rule,
+          svgpp::tag::attribute::stroke,
+          svgpp::tag::attribute::stroke_width,
+          svgpp::tag::attribute::stroke_linejoin,
+          svgpp::tag::attribute::stroke_linecap,
+          svgpp::tag::attribute::stroke_miterlimit,
+          boost::mpl::pair<svgpp::tag::element::use_, svgpp::tag::attribute::xlink::href>,
+          boost::mpl::pair<svgpp::tag::element::use_, svgpp::tag::attribute::x>,
+          boost::mpl::pair<svgpp::tag::element::use_, svgpp::tag::attribute::y>
+            >
+          >
+        >,
+    boost::mpl::set0<>,
+    boost::mpl::insert<boost::mpl::_1, boost::mpl::_2>
+      >::type;
+
+  // path data is read last so that it sees the element's transform and style
+  struct attribute_traversal_policy : svgpp::policy::attribute_traversal::default_policy {
+    struct get_deferred_attributes_by_element {
+      template <typename Element>
+        struct apply {
+          typedef typename boost::mpl::if_<
+            boost::is_same<Element, svgpp::tag::element::path>,
+            boost::mpl::set1<svgpp::tag::attribute::d>,
+            typename boost::mpl::if_<
+              boost::mpl::or_<
+                boost::is_same<Element, svgpp::tag::element::polygon>,
+                boost::is_same<Element, svgpp::tag::element::polyline>
+                >,
+              boost::mpl::set1<svgpp::tag::attribute::points>,
+              boost::mpl::set0<>
+                >::type
+              >::type type;
+        };
+    };
+  };
+
+  // defs and symbol are left out, their contents are only drawn through <use>
   using processed_element_t = boost::mpl::set<
     svgpp::tag::element::svg,
     svgpp::tag::element::g,
@@ -148,8 +278,23 @@ namespace svg {
     svgpp::tag::element::path,
     svgpp::tag::element::polygon,
     svgpp::tag::element::polyline,
-    svgpp::tag::element::rect
+    svgpp::tag::element::rect,
+    svgpp::tag::element::use_
       >;
+
+  // elements that may be loaded as the target of a <use>
+  using referenced_element_t = boost::mpl::insert<
+    processed_element_t,
+    svgpp::tag::element::symbol
+      >::type;
 } /* namespace svg */
 
+namespace svgpp {
+  // parse, adapt and transform in the precision of the rest of the pipeline
+  template <>
+    struct number_type_by_context<svg::reader::context> {
+      typedef Float type;
+    };
+} /* namespace svgpp */
+
 #endif /* SVG_READER_HPP */
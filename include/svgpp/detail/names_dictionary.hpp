@@ -22,6 +22,8 @@
 #include <boost/preprocessor/wstringize.hpp>
 #include <cstring>
 #include <cwchar>
+#include <vector>
+#include <boost/cstdint.hpp>
 
 namespace svgpp { namespace detail {
 
@@ -70,97 +72,115 @@ struct css_property_name_to_id: dictionary_base<attribute_id>
   inline static boost::iterator_range<value_type<Ch> const *> const & get_map();
 };
 
+// Perfect hash of the keys of a dictionary, built on first use: the seed is
+// chosen so that every key has a slot of its own, so a lookup hashes the name
+// once and compares it with at most one key.
+template<class ValuesHolder, class Ch, bool IgnoreCase>
+class perfect_hash_index
+{
+public:
+  typedef typename ValuesHolder::template value_type<Ch> value_type;
+
+  static perfect_hash_index const & get()
+  {
+    static const perfect_hash_index index;
+    return index;
+  }
+
+  template<class Iterator>
+  value_type const * find(Iterator begin, Iterator end) const
+  {
+    size_t length = 0;
+    boost::uint32_t const h = hash(seed_, begin, end, length) & mask_;
+    value_type const * item = slots_[h];
+    if (item == NULL || item->key_length != length)
+      return NULL;
+    for (Ch const * key = item->key; begin != end; ++begin, ++key)
+      if (fold(*begin) != static_cast<boost::uint32_t>(*key))
+        return NULL;
+    return item;
+  }
+
+private:
+  std::vector<value_type const *> slots_;
+  boost::uint32_t seed_;
+  boost::uint32_t mask_;
+
+  template<class Char>
+  static boost::uint32_t fold(Char c)
+  {
+    boost::uint32_t const u = static_cast<boost::uint32_t>(c);
+    // keys of case insensitive dictionaries are lower case ASCII
+    return IgnoreCase && u - 'A' < 26 ? u + ('a' - 'A') : u;
+  }
+
+  // FNV-1a with the seed mixed into the offset basis
+  template<class Iterator>
+  static boost::uint32_t hash(boost::uint32_t seed, Iterator begin, Iterator end, size_t & length)
+  {
+    boost::uint32_t h = 2166136261u ^ seed;
+    for (; begin != end; ++begin, ++length)
+      h = (h ^ fold(*begin)) * 16777619u;
+    return h ^ (h >> 15);
+  }
+
+  perfect_hash_index()
+  {
+    boost::iterator_range<value_type const *> const & map = ValuesHolder::template get_map<Ch>();
+    size_t size = 1;
+    while (size < 2 * static_cast<size_t>(map.size()))
+      size *= 2;
+    // a few dozen seeds suffice at this load; grow the table if they do not
+    for (;; size *= 2)
+    {
+      mask_ = static_cast<boost::uint32_t>(size - 1);
+      for (seed_ = 0; seed_ < 1000; ++seed_)
+      {
+        slots_.assign(size, NULL);
+        bool collision = false;
+        for (value_type const * item = boost::begin(map); item != boost::end(map) && !collision; ++item)
+        {
+          size_t length = 0;
+          value_type const * & slot = slots_[hash(seed_, item->key, item->key + item->key_length, length) & mask_];
+          collision = slot != NULL;
+          slot = item;
+        }
+        if (!collision)
+          return;
+      }
+    }
+  }
+};
+
 template<class ValuesHolder, typename ValuesHolder::mapped_type NotFoundValue>
 struct static_dictionary
 {
   template<class Range>
   static typename ValuesHolder::mapped_type find(Range const & key)
   {
-    return find(boost::as_literal(key), key_less());
+    return find<false>(boost::as_literal(key));
   }
 
   template<class Range>
   static typename ValuesHolder::mapped_type find_ignore_case(Range const & key)
   {
     typedef typename ValuesHolder::lower_case_values check;
-    return find(boost::as_literal(key), key_iless());
+    return find<true>(boost::as_literal(key));
   }
 
 private:
-  template<class Range, class Pred>
-  static typename ValuesHolder::mapped_type find(Range const & key, Pred const & pred)
+  template<bool IgnoreCase, class Range>
+  static typename ValuesHolder::mapped_type find(Range const & key)
   {
     typedef typename boost::range_const_iterator<Range>::type iterator_type;
     typedef typename std::iterator_traits<iterator_type>::value_type char_type;
-    typedef typename ValuesHolder::template value_type<char_type> value_type;
-    typedef boost::iterator_range<value_type const *> map_type;
+    typedef perfect_hash_index<ValuesHolder, char_type, IgnoreCase> index_type;
 
-    map_type map = ValuesHolder::template get_map<char_type>();
-    typename map_type::const_iterator item = std::lower_bound(boost::begin(map), boost::end(map), key, pred);
-    if (item == boost::end(map) || pred(key, *item))
+    typename index_type::value_type const * item = index_type::get().find(boost::begin(key), boost::end(key));
+    if (item == NULL)
       return NotFoundValue;
     return item->value;
   }
-
-  struct key_less
-  {
-    template<class Range, class Char>
-    bool operator()(
-      const Range & lhs,
-      typename ValuesHolder::template value_type<Char> const & rhs) const
-    {
-      return std::lexicographical_compare(
-        boost::begin(lhs),
-        boost::end(lhs),
-        rhs.key,
-        rhs.key + rhs.key_length);
-    }
-
-    template<class Range, class Char>
-    bool operator()(
-      typename ValuesHolder::template value_type<Char> const & lhs,
-      const Range & rhs) const
-    {
-      return std::lexicographical_compare(
-        lhs.key,
-        lhs.key + lhs.key_length,
-        boost::begin(rhs),
-        boost::end(rhs));
-    }
-  };
-
-  struct key_iless
-  {
-  private:
-    boost::algorithm::is_iless is_iless_;
-
-  public:
-    template<class Range, class Char>
-    bool operator()(
-      const Range & lhs,
-      typename ValuesHolder::template value_type<Char> const & rhs) const
-    {
-      return std::lexicographical_compare(
-        boost::begin(lhs),
-        boost::end(lhs),
-        rhs.key,
-        rhs.key + rhs.key_length,
-        is_iless_);
-    }
-
-    template<class Range, class Char>
-    bool operator()(
-      typename ValuesHolder::template value_type<Char> const & lhs,
-      const Range & rhs) const
-    {
-      return std::lexicographical_compare(
-        lhs.key,
-        lhs.key + lhs.key_length,
-        boost::begin(rhs),
-        boost::end(rhs),
-        is_iless_);
-    }
-  };
 };
 
 #define BOOST_PP_FILENAME_1 <svgpp/detail/names_dictionary.hpp>
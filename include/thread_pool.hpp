@@ -0,0 +1,40 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+/*
+ * Fixed set of worker threads running queued tasks. wait() blocks until every
+ * submitted task has finished and rethrows the first exception a task threw.
+ */
+class thread_pool {
+  private:
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_task_ready;
+    std::condition_variable m_all_done;
+    size_t m_n_pending = 0;
+    bool m_stopping = false;
+    std::exception_ptr m_error;
+
+    void work();
+
+  public:
+    explicit thread_pool(size_t n_threads);
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+    ~thread_pool();
+
+    void submit(std::function<void()> task);
+    void wait();
+    size_t size() const;
+}; /* class thread_pool */
+
+#endif /* THREAD_POOL_HPP */
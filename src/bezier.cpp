@@ -2,12 +2,12 @@
 #include "math/util.hpp"
 #include "math/matrix.hpp"
 
-namespace bezier {
-  inline float angle_between(const vector2f& u, const vector2f& v) {
-    return std::acos(u.dot(v) / (u.size_sq() * v.size_sq()));
-  }
+#ifdef __SSE__
+#include <immintrin.h>
+#endif
 
-  vector2f curve(std::vector<vector2f> points, float t) {
+namespace bezier {
+  vector2f curve(std::vector<vector2f> points, Float t) {
     ASSERT(points.size() > 1);
     for (size_t step = 1; step <= points.size()-1; ++step) {
       for (size_t i = 0; i < points.size()-step; ++i) {
@@ -17,47 +17,269 @@ namespace bezier {
     return points.front();
   }
 
-  vector2f elliptical_curve(
+  void quadratic_curve_samples(
+      const vector2f& p0,
+      const vector2f& p1,
+      const vector2f& p2,
+      size_t n,
+      vector2f* out)
+  {
+    ASSERT(n > 0);
+    // B(t) = a t^2 + b t + p0
+    const double h   = 1.0 / n;
+    const double ax  = p0.x - 2.0 * p1.x + p2.x;
+    const double ay  = p0.y - 2.0 * p1.y + p2.y;
+    const double bx  = 2.0 * (p1.x - p0.x);
+    const double by  = 2.0 * (p1.y - p0.y);
+
+    double fx = p0.x, fy = p0.y;
+    double d1x = ax * h * h + bx * h;
+    double d1y = ay * h * h + by * h;
+    const double d2x = 2.0 * ax * h * h;
+    const double d2y = 2.0 * ay * h * h;
+
+    for (size_t i = 0; i + 1 < n; ++i) {
+      fx += d1x; fy += d1y;
+      d1x += d2x; d1y += d2y;
+      out[i] = vector2f(fx, fy);
+    }
+    out[n-1] = p2;
+  }
+
+  void cubic_curve_samples(
+      const vector2f& p0,
+      const vector2f& p1,
+      const vector2f& p2,
+      const vector2f& p3,
+      size_t n,
+      vector2f* out)
+  {
+    ASSERT(n > 0);
+    // B(t) = a t^3 + b t^2 + c t + p0
+    const double h   = 1.0 / n;
+    const double h2  = h * h;
+    const double h3  = h2 * h;
+    const double ax  = -p0.x + 3.0 * (p1.x - p2.x) + p3.x;
+    const double ay  = -p0.y + 3.0 * (p1.y - p2.y) + p3.y;
+    const double bx  = 3.0 * (p0.x - 2.0 * p1.x + p2.x);
+    const double by  = 3.0 * (p0.y - 2.0 * p1.y + p2.y);
+    const double cx  = 3.0 * (p1.x - p0.x);
+    const double cy  = 3.0 * (p1.y - p0.y);
+
+    double fx = p0.x, fy = p0.y;
+    double d1x = ax * h3 + bx * h2 + cx * h;
+    double d1y = ay * h3 + by * h2 + cy * h;
+    double d2x = 6.0 * ax * h3 + 2.0 * bx * h2;
+    double d2y = 6.0 * ay * h3 + 2.0 * by * h2;
+    const double d3x = 6.0 * ax * h3;
+    const double d3y = 6.0 * ay * h3;
+
+    for (size_t i = 0; i + 1 < n; ++i) {
+      fx += d1x; fy += d1y;
+      d1x += d2x; d1y += d2y;
+      d2x += d3x; d2y += d3y;
+      out[i] = vector2f(fx, fy);
+    }
+    out[n-1] = p3;
+  }
+
+#if defined(USE_DOUBLE_AS_FLOAT) && defined(__AVX__)
+  typedef __m256d lane_t;
+  static constexpr size_t LANES = 4;
+  inline lane_t lane_load(const Float* p)       { return _mm256_load_pd(p); }
+  inline lane_t lane_set1(Float v)              { return _mm256_set1_pd(v); }
+  inline lane_t lane_add(lane_t a, lane_t b)    { return _mm256_add_pd(a, b); }
+  inline lane_t lane_sub(lane_t a, lane_t b)    { return _mm256_sub_pd(a, b); }
+  inline lane_t lane_mul(lane_t a, lane_t b)    { return _mm256_mul_pd(a, b); }
+  inline void lane_store(Float* p, lane_t v)    { _mm256_store_pd(p, v); }
+#elif defined(USE_DOUBLE_AS_FLOAT) && defined(__SSE__)
+  // x86-64 always has SSE2 along with SSE
+  typedef __m128d lane_t;
+  static constexpr size_t LANES = 2;
+  inline lane_t lane_load(const Float* p)       { return _mm_load_pd(p); }
+  inline lane_t lane_set1(Float v)              { return _mm_set1_pd(v); }
+  inline lane_t lane_add(lane_t a, lane_t b)    { return _mm_add_pd(a, b); }
+  inline lane_t lane_sub(lane_t a, lane_t b)    { return _mm_sub_pd(a, b); }
+  inline lane_t lane_mul(lane_t a, lane_t b)    { return _mm_mul_pd(a, b); }
+  inline void lane_store(Float* p, lane_t v)    { _mm_store_pd(p, v); }
+#elif defined(__AVX__)
+  typedef __m256 lane_t;
+  static constexpr size_t LANES = 8;
+  inline lane_t lane_load(const Float* p)       { return _mm256_load_ps(p); }
+  inline lane_t lane_set1(Float v)              { return _mm256_set1_ps(v); }
+  inline lane_t lane_add(lane_t a, lane_t b)    { return _mm256_add_ps(a, b); }
+  inline lane_t lane_sub(lane_t a, lane_t b)    { return _mm256_sub_ps(a, b); }
+  inline lane_t lane_mul(lane_t a, lane_t b)    { return _mm256_mul_ps(a, b); }
+  inline void lane_store(Float* p, lane_t v)    { _mm256_store_ps(p, v); }
+#elif defined(__SSE__)
+  typedef __m128 lane_t;
+  static constexpr size_t LANES = 4;
+  inline lane_t lane_load(const Float* p)       { return _mm_load_ps(p); }
+  inline lane_t lane_set1(Float v)              { return _mm_set1_ps(v); }
+  inline lane_t lane_add(lane_t a, lane_t b)    { return _mm_add_ps(a, b); }
+  inline lane_t lane_sub(lane_t a, lane_t b)    { return _mm_sub_ps(a, b); }
+  inline lane_t lane_mul(lane_t a, lane_t b)    { return _mm_mul_ps(a, b); }
+  inline void lane_store(Float* p, lane_t v)    { _mm_store_ps(p, v); }
+#endif
+
+#if defined(__SSE__)
+  struct lane_cubic {
+    // B(t) = ((a t + b) t + c) t + d
+    lane_t a, b, c, d;
+
+    lane_cubic(const Float* p0, const Float* p1, const Float* p2, const Float* p3) {
+      const lane_t v0 = lane_load(p0), v1 = lane_load(p1);
+      const lane_t v2 = lane_load(p2), v3 = lane_load(p3);
+      const lane_t three = lane_set1(3.0f);
+      a = lane_add(lane_sub(v3, v0), lane_mul(three, lane_sub(v1, v2)));
+      b = lane_mul(three, lane_sub(lane_add(v0, v2), lane_add(v1, v1)));
+      c = lane_mul(three, lane_sub(v1, v0));
+      d = v0;
+    }
+
+    lane_t operator()(lane_t t) const {
+      return lane_add(lane_mul(lane_add(lane_mul(lane_add(lane_mul(a, t), b), t), c), t), d);
+    }
+  };
+
+  void cubic_batch_samples(const cubic_batch& batch, vector2f* const* out) {
+    alignas(32) Float h[cubic_batch::WIDTH];
+    alignas(32) Float xs[LANES];
+    alignas(32) Float ys[LANES];
+
+    for (size_t lane = 0; lane < cubic_batch::WIDTH; ++lane) {
+      h[lane] = lane < batch.size ? 1.0f / batch.n_segments[lane] : 0.0f;
+    }
+
+    for (size_t base = 0; base < batch.size; base += LANES) {
+      const size_t n_lanes = std::min(LANES, batch.size - base);
+      const lane_cubic bx(
+          batch.x[0] + base, batch.x[1] + base, batch.x[2] + base, batch.x[3] + base
+          );
+      const lane_cubic by(
+          batch.y[0] + base, batch.y[1] + base, batch.y[2] + base, batch.y[3] + base
+          );
+      const lane_t step = lane_load(h + base);
+
+      size_t max_n = 0;
+      for (size_t lane = 0; lane < n_lanes; ++lane) {
+        max_n = std::max(max_n, batch.n_segments[base + lane]);
+      }
+
+      for (size_t i = 1; i < max_n; ++i) {
+        const lane_t t = lane_mul(lane_set1(static_cast<Float>(i)), step);
+        lane_store(xs, bx(t));
+        lane_store(ys, by(t));
+        for (size_t lane = 0; lane < n_lanes; ++lane) {
+          if (i < batch.n_segments[base + lane]) {
+            out[base + lane][i-1] = vector2f(xs[lane], ys[lane]);
+          }
+        }
+      }
+
+      // pin end points exactly
+      for (size_t lane = 0; lane < n_lanes; ++lane) {
+        const size_t n = batch.n_segments[base + lane];
+        out[base + lane][n-1] = vector2f(batch.x[3][base + lane], batch.y[3][base + lane]);
+      }
+    }
+  }
+#else
+#warning Not using SSE to flatten cubic batches
+  void cubic_batch_samples(const cubic_batch& batch, vector2f* const* out) {
+    for (size_t lane = 0; lane < batch.size; ++lane) {
+      cubic_curve_samples(
+          { batch.x[0][lane], batch.y[0][lane] },
+          { batch.x[1][lane], batch.y[1][lane] },
+          { batch.x[2][lane], batch.y[2][lane] },
+          { batch.x[3][lane], batch.y[3][lane] },
+          batch.n_segments[lane],
+          out[lane]
+          );
+    }
+  }
+#endif
+
+  elliptical_arc::elliptical_arc(
       const vector2f& p0,
       const vector2f& p1,
       const vector2f& r,
       bool large_arc_flag,
       bool sweep_flag,
-      float x_axis_rotation,
-      float t
-      )
+      Float x_axis_rotation)
+    : m_p0(p0), m_p1(p1), m_center(0.5f * (p0 + p1)), m_r(std::abs(r.x), std::abs(r.y))
   {
-    // convert endpoint parameterization to center parameterization
-    // see https://www.w3.org/TR/SVG/implnote.html#ArcConversionEndpointToCenter
-    static constexpr float two_pi = 6.28318530718f;
-    const float neg     = (large_arc_flag == sweep_flag) ? -1.0f : 1.0f;
-    const float sine    = std::sin(x_axis_rotation);
-    const float cosine  = std::cos(x_axis_rotation);
-    const float rx_sq   = pow2(r.x);
-    const float ry_sq   = pow2(r.y);
-    matrix2f rot_mat { { cosine, sine }, { -sine, cosine } };
-    vector2f p0p = rot_mat.dot(p0 - p1) / 2.0f;
-
-    const float x0p_sq = pow2(p0p.x);
-    const float y0p_sq = pow2(p0p.y);
-    const vector2f cp = neg * (
-        1.f / std::sqrt(
-          (rx_sq * y0p_sq + ry_sq * x0p_sq) / (rx_sq * ry_sq - rx_sq * y0p_sq - ry_sq * x0p_sq))
-        ) * vector2f(r.x / r.y * y0p_sq, -r.y / r.x * x0p_sq);
-
-    const vector2f c = rot_mat.t().dot(cp) + (p0 + p1) / 2.0f;
-    const float theta0  = angle_between(
-        { 1.0f, 0.0f }, { (p0p.x - cp.x) / r.x, (p0p.y - cp.y) / r.y }
-        );
-    float dtheta = std::fmod(angle_between(
-        { (p0p.x - cp.x) / r.x, (p0p.y - cp.y) / r.y    },
-        { (-p0p.x - cp.x) / r.x, (-p0p.y - cp.y) / r.y  }
-        ), two_pi);
-
-    if (sweep_flag && dtheta < 0.0f) dtheta += two_pi;
-    else if (!sweep_flag && dtheta > 0.0f) dtheta -= two_pi;
-
-    const float angle = theta0 + t * dtheta;
-    return c + vector2f(r.x * std::cos(angle), r.y * std::sin(angle));
+    if (COMPARE_EQ(m_r.x, 0) || COMPARE_EQ(m_r.y, 0) || (p0 - p1).is_zero()) {
+      m_is_line = true;
+      return;
+    }
+
+    const Float phi = radians(x_axis_rotation);
+    m_cos_phi = std::cos(phi);
+    m_sin_phi = std::sin(phi);
+
+    // step 1: rotate the half chord into the ellipse's frame
+    const vector2f d = 0.5f * (p0 - p1);
+    const vector2f p0p(m_cos_phi * d.x + m_sin_phi * d.y, -m_sin_phi * d.x + m_cos_phi * d.y);
+
+    // scale up radii that are too small to reach both end points
+    const Float lambda = pow2(p0p.x / m_r.x) + pow2(p0p.y / m_r.y);
+    if (lambda > 1.0f) m_r *= std::sqrt(lambda);
+
+    // step 2: center in the ellipse's frame
+    const Float rx_sq   = pow2(m_r.x);
+    const Float ry_sq   = pow2(m_r.y);
+    const Float x0p_sq  = pow2(p0p.x);
+    const Float y0p_sq  = pow2(p0p.y);
+    const Float num     = rx_sq * ry_sq - rx_sq * y0p_sq - ry_sq * x0p_sq;
+    const Float den     = rx_sq * y0p_sq + ry_sq * x0p_sq;
+    const Float coef    = (large_arc_flag == sweep_flag ? -1.0f : 1.0f)
+      * std::sqrt(max0(num / den));
+    const vector2f cp(coef * m_r.x * p0p.y / m_r.y, -coef * m_r.y * p0p.x / m_r.x);
+
+    // step 3: center in user space
+    m_center += vector2f(m_cos_phi * cp.x - m_sin_phi * cp.y, m_sin_phi * cp.x + m_cos_phi * cp.y);
+
+    // step 4: start angle and sweep
+    const vector2f u((p0p.x - cp.x) / m_r.x, (p0p.y - cp.y) / m_r.y);
+    const vector2f v((-p0p.x - cp.x) / m_r.x, (-p0p.y - cp.y) / m_r.y);
+    m_theta0 = std::atan2(u.y, u.x);
+    m_dtheta = std::atan2(u.x * v.y - u.y * v.x, u.dot(v));
+    if (!sweep_flag && m_dtheta > 0.0f) m_dtheta -= TWO_PI;
+    else if (sweep_flag && m_dtheta < 0.0f) m_dtheta += TWO_PI;
+  }
+
+  vector2f elliptical_arc::point(Float t) const {
+    if (m_is_line) return lerp(t, m_p0, m_p1);
+    const Float angle = m_theta0 + t * m_dtheta;
+    const Float ex = m_r.x * std::cos(angle);
+    const Float ey = m_r.y * std::sin(angle);
+    return m_center + vector2f(m_cos_phi * ex - m_sin_phi * ey, m_sin_phi * ex + m_cos_phi * ey);
+  }
+
+  void elliptical_arc::samples(size_t n, vector2f* out) const {
+    ASSERT(n > 0);
+    if (m_is_line) {
+      for (size_t i = 0; i < n; ++i) out[i] = lerp((Float) (i + 1) / n, m_p0, m_p1);
+      return;
+    }
+
+    const double step   = (double) m_dtheta / n;
+    const double cos_dt = std::cos(step);
+    const double sin_dt = std::sin(step);
+    double ux = std::cos((double) m_theta0);
+    double uy = std::sin((double) m_theta0);
+    for (size_t i = 0; i + 1 < n; ++i) {
+      const double rx = ux * cos_dt - uy * sin_dt;
+      uy = ux * sin_dt + uy * cos_dt;
+      ux = rx;
+      const double ex = m_r.x * ux;
+      const double ey = m_r.y * uy;
+      out[i] = vector2f(
+          m_center.x + m_cos_phi * ex - m_sin_phi * ey,
+          m_center.y + m_sin_phi * ex + m_cos_phi * ey
+          );
+    }
+    out[n-1] = m_p1;
   }
 }
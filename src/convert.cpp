@@ -0,0 +1,593 @@
+#include "convert.hpp"
+
+#include <string>
+#include <memory>
+#include <array>
+#include <deque>
+#include <algorithm>
+#include <unordered_map>
+#include <cmath>
+#include <cstdio>
+
+#include "fill.hpp"
+#include "stroke.hpp"
+#include "simplify.hpp"
+#include "mesh.hpp"
+#include "mesh_writer.hpp"
+
+namespace convert {
+  const std::string SCAD_DISCLAIMER =
+  "/*\n"
+  " * This file is generated with svg2scad.\n"
+  " * Direct modification to its contents is discouraged.\n"
+  " */\n";
+
+  const std::string SCAD_PREAMBLE = "function svg_distance(p0,p1)=sqrt((p0.x-p1.x)*(p0.x-p1.x)+(p0.y-p1.y)*(p0.y-p1.y));function svg_normalize(v)=v/svg_distance(v,[0,0]);";
+
+  const std::string SCAD_MODULE_DRAW_LINE = "module svg_line(p0,p1,thickness,depth){size=svg_distance(p0,p1);angle=atan2(p1.y-p0.y,p1.x-p0.x);translate(p0){rotate(angle,[0,0,1]){translate([0,-0.5*thickness,0]){scale([size,thickness,depth]){cube([1,1,1]);}}}}}";
+
+  const std::string SCAD_MODULE_DRAW_VERTICES = "module svg_curve(vertices,thickness,depth){extent=0.5*thickness;n_segments=len(vertices)-1;union(){for(i=[0:n_segments-1]){p=vertices[max(0,i-1)];p0=vertices[i];p1=vertices[i+1];tangent0=p0-p;tangent1=p1-p0;normal0=svg_normalize([tangent0.y,-tangent0.x]);normal1=svg_normalize([tangent1.y,-tangent1.x]);fpr0=p0+extent*normal0;fpr1=p0+extent*normal1;fpl0=p0-extent*normal0;fpl1=p0-extent*normal1;svg_line(p0,p1,thickness,depth);color([1,0,0])linear_extrude(depth)polygon([p0,fpr0,fpr1]);color([0,1,0])linear_extrude(depth)polygon([p0,fpl0,fpl1]);}}}";
+
+  /*
+   * Distinct shape bodies of one document for --dedupe, numbered in order of
+   * first appearance. A body is formatted relative to its anchor point into
+   * body(), and print_instance() then places it at the anchor, so translated
+   * copies share one module. Every distinct body is kept until print_modules().
+   */
+  class scad_shape_table {
+    private:
+      const std::string m_prefix;
+      const int m_precision;
+      std::unordered_map<std::string, size_t> m_ids;
+      std::vector<const std::string*> m_bodies;
+      std::string m_body;
+      output::writer m_body_out;
+
+      void print_name(output::writer& out, size_t id) const {
+        char index[24];
+        out << m_prefix;
+        out.write(index, std::snprintf(index, sizeof(index), "%zu", id));
+      }
+
+    public:
+      scad_shape_table(const std::string& module_name, int precision)
+        : m_prefix(module_name + "_shape_"), m_precision(precision),
+        m_body_out([this](const char* data, size_t n) { m_body.append(data, n); }, precision) {}
+
+      /*
+       * Move vertices [first, last) so that the first one lies at the origin and
+       * return where it was. Offsets are rounded to the resolution coordinates
+       * of this size are printed with anyway, so that copies differing only in
+       * rounding noise share a body.
+       */
+      vector2f anchor(flatten::vertex* first, flatten::vertex* last) const {
+        const vector2f origin = first->position;
+        Float magnitude = 0;
+        for (const flatten::vertex* v = first; v != last; ++v) {
+          magnitude = std::max({ magnitude, std::abs(v->position.x), std::abs(v->position.y) });
+        }
+        const Float quantum = m_precision > 0 && magnitude > 0
+          ? std::pow(10.0, std::floor(std::log10(magnitude)) - m_precision + 1) : 0;
+        for (flatten::vertex* v = first; v != last; ++v) {
+          v->position -= origin;
+          if (quantum > 0) {
+            v->position = quantum * vector2f(
+                std::nearbyint(v->position.x / quantum), std::nearbyint(v->position.y / quantum));
+          }
+        }
+        return origin;
+      }
+
+      output::writer& body() {
+        return m_body_out;
+      }
+
+      void print_instance(output::writer& out, const vector2f& anchor) {
+        m_body_out.flush();
+        if (m_body.empty()) return;
+        auto inserted = m_ids.emplace(std::move(m_body), m_bodies.size());
+        if (inserted.second) m_bodies.push_back(&inserted.first->first);
+        m_body.clear();
+
+        out << "translate([" << anchor.x << ',' << anchor.y << "])";
+        print_name(out, inserted.first->second);
+        out << "(thickness,depth);\n";
+      }
+
+      void print_modules(output::writer& out) const {
+        for (size_t id = 0; id < m_bodies.size(); ++id) {
+          out << "module ";
+          print_name(out, id);
+          out << "(thickness,depth) {\n" << *m_bodies[id] << "}\n";
+        }
+      }
+  }; /* class scad_shape_table */
+
+  void scad_print_header(output::writer& out, const scad_options& opts) {
+    out << SCAD_DISCLAIMER << '\n';
+    if (opts.polygons) return;
+    out << SCAD_PREAMBLE << '\n';
+    out << SCAD_MODULE_DRAW_LINE << '\n';
+    out << SCAD_MODULE_DRAW_VERTICES << '\n';
+  }
+
+  void scad_print_vertices_list(
+      output::writer& out,
+      const flatten::vertex* first,
+      const flatten::vertex* last)
+  {
+    out << '[';
+    for (const flatten::vertex* v = first; v != last; ++v) {
+      out << '[' << v->position.x << ',' << v->position.y << ']';
+      if ((v + 1) != last) {
+        out << ',';
+      }
+    }
+    out << ']';
+  }
+
+  void scad_print_line(output::writer& out, const vector2f& from, const vector2f& to) {
+    out << "svg_line([" << from.x << ',' << from.y << "],"
+      << '[' << to.x << ',' << to.y << "],thickness,depth);\n";
+  }
+
+  void scad_print_curve(
+      output::writer& out,
+      const flatten::vertex* first,
+      const flatten::vertex* last)
+  {
+    if (first == last) return;
+    out << "svg_curve(";
+    scad_print_vertices_list(out, first, last);
+    out << ",thickness,depth);\n";
+  }
+
+  // one polygon() holding every ring, with a path list only if there are several
+  void scad_print_polygon(
+      output::writer& out,
+      const std::vector<flatten::vertex>& vertices,
+      const std::vector<fill::ring>& rings)
+  {
+    if (rings.empty()) return;
+    out << "polygon([";
+    for (size_t r = 0; r < rings.size(); ++r) {
+      if (r > 0) out << ',';
+      const flatten::vertex* first = vertices.data() + rings[r].first;
+      const flatten::vertex* last = vertices.data() + rings[r].last;
+      for (const flatten::vertex* v = first; v != last; ++v) {
+        if (v != first) out << ',';
+        out << '[' << v->position.x << ',' << v->position.y << ']';
+      }
+    }
+    out << ']';
+    if (rings.size() > 1) {
+      char index[24];
+      size_t point = 0;
+      out << ",[";
+      for (size_t r = 0; r < rings.size(); ++r) {
+        if (r > 0) out << ',';
+        out << '[';
+        for (size_t i = rings[r].first; i < rings[r].last; ++i, ++point) {
+          if (i > rings[r].first) out << ',';
+          out.write(index, std::snprintf(index, sizeof(index), "%zu", point));
+        }
+        out << ']';
+      }
+      out << ']';
+    }
+    out << ");\n";
+  }
+
+  void flatten_commands(
+      const svg::path& path,
+      const svg::path::range& commands,
+      const scad_options& opts,
+      std::vector<flatten::vertex>& vertices)
+  {
+    stats::scope flatten_scope(opts.stats, stats::STAGE_FLATTEN);
+    vertices.clear();
+    flatten::builder vertex_builder(vertices, opts.flatten);
+    path.visit(vertex_builder, commands);
+    vertex_builder.finish();
+    if (opts.simplify_tolerance > 0) {
+      thread_local simplify::simplifier simplifier;
+      simplifier(vertices, opts.simplify_tolerance);
+    }
+    if (opts.stats) opts.stats->add_vertices(vertices.size());
+  }
+
+  // one polygon() per stroke piece, since pieces overlap
+  void scad_print_stroke(
+      output::writer& out,
+      const std::vector<vector2f>& points,
+      const std::vector<size_t>& piece_ends)
+  {
+    size_t first = 0;
+    for (const size_t last : piece_ends) {
+      out << "polygon([";
+      for (size_t i = first; i < last; ++i) {
+        if (i > first) out << ',';
+        out << '[' << points[i].x << ',' << points[i].y << ']';
+      }
+      out << "]);\n";
+      first = last;
+    }
+  }
+
+  /*
+   * Call fn(shape_commands, paint) for every painted shape starting within
+   * commands, with the stroke width override of opts applied.
+   */
+  template <typename Function>
+  void for_each_shape(
+      const svg::path& path,
+      const svg::path::range& commands,
+      const scad_options& opts,
+      Function fn)
+  {
+    auto visit_shape = [&](const svg::path::range& shape_commands, svg::style paint) {
+      if (opts.stroke_width > 0) {
+        paint.stroked = true;
+        paint.stroke_width = opts.stroke_width;
+      }
+      if (paint.filled || paint.stroked) fn(shape_commands, paint);
+    };
+
+    const std::vector<svg::path::shape>& shapes = path.shapes();
+    if (shapes.empty()) {
+      visit_shape(commands, svg::style());
+      return;
+    }
+    auto shape = std::lower_bound(
+        shapes.begin(), shapes.end(), commands.first,
+        [](const svg::path::shape& s, size_t first) { return s.first < first; }
+        );
+    for (; shape != shapes.end() && shape->first < commands.last; ++shape) {
+      visit_shape(path.shape_commands(shape - shapes.begin()), shape->paint);
+    }
+  }
+
+  /*
+   * Print the painted shapes starting within commands as polygons. With a
+   * shape table, every shape is printed through it as one instance.
+   */
+  void scad_print_shapes(
+      output::writer& out,
+      const svg::path& path,
+      const svg::path::range& commands,
+      const scad_options& opts,
+      std::vector<flatten::vertex>& vertices,
+      scad_shape_table* table)
+  {
+    thread_local std::vector<fill::ring> rings;
+    thread_local std::vector<vector2f> stroke_points;
+    thread_local std::vector<size_t> stroke_piece_ends;
+    for_each_shape(path, commands, opts,
+        [&](const svg::path::range& shape_commands, const svg::style& paint) {
+          flatten_commands(path, shape_commands, opts, vertices);
+          if (vertices.empty()) return;
+          vector2f anchor;
+          if (table) anchor = table->anchor(&vertices.front(), &vertices.back() + 1);
+          output::writer& shape_out = table ? table->body() : out;
+          if (paint.filled) {
+            fill::collect_rings(vertices, rings);
+            fill::select_rings(vertices, paint.fill_rule, rings);
+            scad_print_polygon(shape_out, vertices, rings);
+          }
+          if (paint.stroked) {
+            stroke_points.clear();
+            stroke_piece_ends.clear();
+            stroke::outline(
+                vertices, stroke::options(paint, opts.flatten), stroke_points, stroke_piece_ends
+                );
+            scad_print_stroke(shape_out, stroke_points, stroke_piece_ends);
+          }
+          if (table) table->print_instance(out, anchor);
+        });
+  }
+
+  // flatten commands into vertices, which is only scratch space, and print their subpaths
+  void scad_print_commands(
+      output::writer& out,
+      const svg::path& path,
+      const svg::path::range& commands,
+      const scad_options& opts,
+      std::vector<flatten::vertex>& vertices,
+      scad_shape_table* table = nullptr)
+  {
+    stats::scope format_scope(opts.stats, stats::STAGE_FORMAT);
+    if (opts.polygons) {
+      scad_print_shapes(out, path, commands, opts, vertices, table);
+      return;
+    }
+
+    flatten_commands(path, commands, opts, vertices);
+    for (size_t i = 0; i < vertices.size(); ++i) {
+      const size_t first = i;
+      while (i < vertices.size() && !vertices[i].moveflag) ++i;
+      if (!table) {
+        scad_print_curve(out, vertices.data() + first, vertices.data() + i);
+        continue;
+      }
+      const vector2f anchor = table->anchor(vertices.data() + first, vertices.data() + i);
+      scad_print_curve(table->body(), vertices.data() + first, vertices.data() + i);
+      table->print_instance(out, anchor);
+    }
+  }
+
+  /*
+   * Print all subpaths of path. With a thread pool, runs of whole subpaths are
+   * flattened and formatted concurrently into separate buffers which are then
+   * written in their original order, so the output does not depend on it.
+   * Shapes are numbered in order of appearance, so a shape table makes it serial.
+   */
+  void scad_print_path(
+      output::writer& out,
+      const svg::path& path,
+      const scad_options& opts,
+      std::vector<flatten::vertex>& vertices,
+      thread_pool* pool,
+      scad_shape_table* table)
+  {
+    static constexpr size_t MIN_PARALLEL_COMMANDS = 4096;
+    static constexpr size_t CHUNK_BUFFER_CAPACITY = 1 << 16;
+
+    if (!pool || table || path.size() < MIN_PARALLEL_COMMANDS) {
+      scad_print_commands(out, path, { 0, path.size(), 0 }, opts, vertices, table);
+      return;
+    }
+
+    // a few ranges per thread to even out subpaths of different cost
+    const std::vector<svg::path::range> ranges = path.split(4 * pool->size(), opts.polygons);
+    std::vector<std::string> chunks(ranges.size());
+    const int precision = out.precision();
+    for (size_t i = 0; i < ranges.size(); ++i) {
+      pool->submit([&, i] {
+        thread_local std::vector<flatten::vertex> chunk_vertices;
+        std::string& chunk = chunks[i];
+        output::writer chunk_out(
+            [&chunk](const char* data, size_t n) { chunk.append(data, n); },
+            precision,
+            CHUNK_BUFFER_CAPACITY
+            );
+        scad_print_commands(chunk_out, path, ranges[i], opts, chunk_vertices);
+        chunk_out.flush();
+      });
+    }
+    pool->wait();
+
+    for (const std::string& chunk : chunks) {
+      out.write(chunk.data(), chunk.size());
+    }
+  }
+
+  // multiply by the matrix of instance, a..f as in SVG's matrix()
+  void scad_print_transform(output::writer& out, const std::array<Float, 6>& m) {
+    out << "multmatrix([[" << m[0] << ',' << m[2] << ",0," << m[4]
+      << "],[" << m[1] << ',' << m[3] << ",0," << m[5] << "],[0,0,1,0]])";
+  }
+
+  void scad_print_definition_name(output::writer& out, const std::string& module_name, size_t id) {
+    char index[24];
+    out << module_name << "_def_";
+    out.write(index, std::snprintf(index, sizeof(index), "%zu", id));
+  }
+
+  // place the definitions path refers to with <use>
+  void scad_print_instances(
+      output::writer& out,
+      const svg::path& path,
+      const std::string& module_name)
+  {
+    for (const svg::path::instance& instance : path.instances()) {
+      scad_print_transform(out, instance.transform);
+      scad_print_definition_name(out, module_name, instance.definition);
+      out << "(thickness,depth);\n";
+    }
+  }
+
+  // print a complete OpenSCAD file for the document reader delivers through paths
+  void scad_print_document(
+      output::writer& out,
+      svg::reader& reader,
+      const path_source& paths,
+      const std::string& module_name,
+      const scad_options& opts,
+      std::vector<flatten::vertex>& vertices,
+      thread_pool* pool)
+  {
+    std::unique_ptr<scad_shape_table> table;
+    if (opts.dedupe) table.reset(new scad_shape_table(module_name, out.precision()));
+    auto print_path = [&](const svg::path& path) {
+      scad_print_path(out, path, opts, vertices, pool, table.get());
+      scad_print_instances(out, path, module_name);
+    };
+
+    scad_print_header(out, opts);
+    out << "module " << module_name << "(thickness=1,depth=1) {\n";
+    // all polygons are unioned in 2D and extruded once
+    if (opts.polygons) out << "linear_extrude(depth) {\n";
+    paths(print_path);
+    if (opts.polygons) out << "}\n";
+    out << "}\n";
+    // OpenSCAD looks modules up by name, so they may follow their use
+    const std::deque<svg::path>& definitions = reader.definitions();
+    for (size_t id = 0; id < definitions.size(); ++id) {
+      out << "module ";
+      scad_print_definition_name(out, module_name, id);
+      out << "(thickness,depth) {\n";
+      print_path(definitions[id]);
+      out << "}\n";
+    }
+    if (table) table->print_modules(out);
+  }
+
+  /*
+   * Triangulate and extrude every painted shape of path into exporter. Fills
+   * become one solid per outer ring with its holes, and every stroke piece
+   * becomes a solid of its own, so solids may overlap as the polygons printed
+   * for OpenSCAD do before it unions them. Definitions placed with <use> are
+   * exported the same way, mapped by the transform of every instance; they are
+   * flattened in their own coordinates, so the tolerance scales with them.
+   */
+  void mesh_export_path(
+      mesh::exporter& exporter,
+      const svg::path& path,
+      const std::deque<svg::path>& definitions,
+      const std::array<Float, 6>& transform,
+      const scad_options& opts,
+      std::vector<flatten::vertex>& vertices)
+  {
+    static const std::array<Float, 6> IDENTITY = {{ 1, 0, 0, 1, 0, 0 }};
+    thread_local mesh::triangulator triangulate;
+    thread_local std::vector<fill::ring> rings;
+    thread_local std::vector<vector2f> points;
+    thread_local std::vector<size_t> ring_ends;
+    const std::array<Float, 6>& m = transform;
+    const bool transformed = m != IDENTITY;
+    const mesh::solid_sink emit = [&](const mesh::solid& s) {
+      stats::scope format_scope(opts.stats, stats::STAGE_FORMAT);
+      exporter.add(s);
+    };
+    stats::scope format_scope(opts.stats, stats::STAGE_FORMAT);
+    for_each_shape(path, { 0, path.size(), 0 }, opts,
+        [&](const svg::path::range& shape_commands, svg::style paint) {
+          flatten_commands(path, shape_commands, opts, vertices);
+          if (transformed) {
+            for (flatten::vertex& v : vertices) {
+              const vector2f p = v.position;
+              v.position = vector2f(m[0] * p.x + m[2] * p.y + m[4], m[1] * p.x + m[3] * p.y + m[5]);
+            }
+            paint.stroke_width *= std::sqrt(std::abs(m[0] * m[3] - m[1] * m[2]));
+          }
+          if (paint.filled) {
+            fill::collect_rings(vertices, rings);
+            fill::select_rings(vertices, paint.fill_rule, rings);
+            points.clear();
+            ring_ends.clear();
+            for (const fill::ring& r : rings) {
+              for (size_t i = r.first; i < r.last; ++i) points.push_back(vertices[i].position);
+              ring_ends.push_back(points.size());
+            }
+            stats::scope triangulate_scope(opts.stats, stats::STAGE_TRIANGULATE);
+            triangulate(points.data(), ring_ends.data(), ring_ends.size(), emit);
+          }
+          if (paint.stroked) {
+            points.clear();
+            ring_ends.clear();
+            stroke::outline(vertices, stroke::options(paint, opts.flatten), points, ring_ends);
+            size_t first = 0;
+            for (const size_t last : ring_ends) {
+              const size_t piece_end = last - first;
+              stats::scope triangulate_scope(opts.stats, stats::STAGE_TRIANGULATE);
+              triangulate(points.data() + first, &piece_end, 1, emit);
+              first = last;
+            }
+          }
+        });
+
+    for (const svg::path::instance& instance : path.instances()) {
+      const std::array<Float, 6>& n = instance.transform;
+      const std::array<Float, 6> composed = {{
+        m[0] * n[0] + m[2] * n[1], m[1] * n[0] + m[3] * n[1],
+        m[0] * n[2] + m[2] * n[3], m[1] * n[2] + m[3] * n[3],
+        m[0] * n[4] + m[2] * n[5] + m[4], m[1] * n[4] + m[3] * n[5] + m[5]
+      }};
+      mesh_export_path(
+          exporter, definitions[instance.definition], definitions, composed, opts, vertices);
+    }
+  }
+
+  // write a complete STL or 3MF file for one SVG document to out, which writes to fd
+  void mesh_export_document(
+      output::writer& out,
+      int fd,
+      svg::reader& reader,
+      const path_source& paths,
+      const scad_options& opts,
+      std::vector<flatten::vertex>& vertices)
+  {
+    std::unique_ptr<mesh::exporter> exporter;
+    if (opts.format == FORMAT_STL) {
+      exporter.reset(new mesh::stl_exporter(out, fd, opts.depth));
+    } else {
+      exporter.reset(new mesh::threemf_exporter(out, opts.depth));
+    }
+    paths([&](const svg::path& path) {
+      mesh_export_path(*exporter, path, reader.definitions(), { { 1, 0, 0, 1, 0, 0 } }, opts, vertices);
+    });
+    exporter->finish();
+  }
+
+  void print_document(
+      output::writer& out,
+      int fd,
+      svg::reader& reader,
+      const path_source& paths,
+      const std::string& module_name,
+      const scad_options& opts,
+      std::vector<flatten::vertex>& vertices,
+      thread_pool* pool)
+  {
+    if (opts.format == FORMAT_SCAD) {
+      scad_print_document(out, reader, paths, module_name, opts, vertices, pool);
+    } else {
+      mesh_export_document(out, fd, reader, paths, opts, vertices);
+    }
+  }
+
+  const char* format_extension(output_format format) {
+    switch (format) {
+      case FORMAT_STL:
+        return ".stl";
+      case FORMAT_3MF:
+        return ".3mf";
+      default:
+        return ".scad";
+    }
+  }
+
+  converter::converter(const scad_options& opts, int precision, thread_pool* pool)
+    : m_opts(opts), m_pool(pool), m_out([](const char*, size_t) {}, precision)
+  {
+    m_reader.set_stats(opts.stats);
+  }
+
+  void converter::print(
+      const output::sink& sink,
+      const path_source& paths,
+      const std::string& module_name)
+  {
+    m_out.redirect(m_opts.stats ? stats::counted_sink(sink, *m_opts.stats) : sink);
+    try {
+      print_document(m_out, -1, m_reader, paths, module_name, m_opts, m_vertices, m_pool);
+      m_out.flush();
+    } catch (...) {
+      m_out.discard();
+      throw;
+    }
+  }
+
+  void converter::convert(
+      const char* svg,
+      size_t size,
+      const output::sink& sink,
+      const std::string& module_name)
+  {
+    m_reader.load_buffer(svg, size);
+    print(sink, [this](const svg::reader::chunk_handler& handler) {
+      handler(m_reader.actions());
+    }, module_name);
+  }
+
+  void converter::convert_streamed(
+      const char* svg,
+      size_t size,
+      const output::sink& sink,
+      const std::string& module_name)
+  {
+    print(sink, [&](const svg::reader::chunk_handler& handler) {
+      m_reader.stream_buffer(svg, size, handler);
+    }, module_name);
+  }
+} /* namespace convert */
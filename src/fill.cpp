@@ -0,0 +1,95 @@
+#include "fill.hpp"
+
+namespace fill {
+  // twice the signed area, positive for counterclockwise rings in a y-up frame
+  inline double signed_area(const flatten::vertex* first, const flatten::vertex* last) {
+    double area = 0;
+    const vector2f* prev = &(last - 1)->position;
+    for (const flatten::vertex* v = first; v != last; ++v) {
+      area += static_cast<double>(prev->x) * v->position.y
+        - static_cast<double>(v->position.x) * prev->y;
+      prev = &v->position;
+    }
+    return area;
+  }
+
+  // number of times the ring winds counterclockwise around p
+  inline int winding_number(
+      const flatten::vertex* first,
+      const flatten::vertex* last,
+      const vector2f& p)
+  {
+    int winding = 0;
+    const vector2f* a = &(last - 1)->position;
+    for (const flatten::vertex* v = first; v != last; ++v) {
+      const vector2f& b = v->position;
+      const double side = static_cast<double>(b.x - a->x) * (p.y - a->y)
+        - static_cast<double>(p.x - a->x) * (b.y - a->y);
+      if (a->y <= p.y) {
+        if (b.y > p.y && side > 0) ++winding;
+      } else {
+        if (b.y <= p.y && side < 0) --winding;
+      }
+      a = &b;
+    }
+    return winding;
+  }
+
+  void collect_rings(const std::vector<flatten::vertex>& vertices, std::vector<ring>& rings) {
+    rings.clear();
+    for (size_t i = 0; i < vertices.size();) {
+      const size_t first = i;
+      for (++i; i < vertices.size() && !vertices[i].moveflag; ++i);
+      size_t last = i;
+      const vector2f& start = vertices[first].position;
+      const vector2f& end = vertices[last - 1].position;
+      if (last - first > 1 && end.x == start.x && end.y == start.y) --last;
+      if (last - first < 3) continue;
+      if (signed_area(vertices.data() + first, vertices.data() + last) == 0) continue;
+      rings.push_back({ first, last });
+    }
+  }
+
+  void select_rings(
+      const std::vector<flatten::vertex>& vertices,
+      svg::style::fill_rule_type fill_rule,
+      std::vector<ring>& rings)
+  {
+    if (fill_rule == svg::style::FILL_RULE_EVENODD || rings.size() < 2) return;
+
+    struct bounds {
+      vector2f min, max;
+    };
+    std::vector<bounds> ring_bounds(rings.size());
+    std::vector<int> orientation(rings.size());
+    for (size_t i = 0; i < rings.size(); ++i) {
+      const flatten::vertex* first = vertices.data() + rings[i].first;
+      const flatten::vertex* last = vertices.data() + rings[i].last;
+      bounds& b = ring_bounds[i];
+      b.min = b.max = first->position;
+      for (const flatten::vertex* v = first; v != last; ++v) {
+        b.min = vector2f(std::min(b.min.x, v->position.x), std::min(b.min.y, v->position.y));
+        b.max = vector2f(std::max(b.max.x, v->position.x), std::max(b.max.y, v->position.y));
+      }
+      orientation[i] = signed_area(first, last) > 0 ? 1 : -1;
+    }
+
+    // a ring is an edge of the nonzero fill only if the winding number of the
+    // other rings is zero on exactly one of its sides
+    std::vector<ring> kept;
+    for (size_t i = 0; i < rings.size(); ++i) {
+      const vector2f& p = vertices[rings[i].first].position;
+      int outside = 0;
+      for (size_t j = 0; j < rings.size(); ++j) {
+        const bounds& b = ring_bounds[j];
+        if (j == i || p.x < b.min.x || p.x > b.max.x || p.y < b.min.y || p.y > b.max.y) continue;
+        outside += winding_number(
+            vertices.data() + rings[j].first, vertices.data() + rings[j].last, p
+            );
+      }
+      const int inside = outside + orientation[i];
+      if ((outside == 0) != (inside == 0)) kept.push_back(rings[i]);
+    }
+    rings.swap(kept);
+  }
+} /* namespace fill */
@@ -0,0 +1,146 @@
+#include "flatten.hpp"
+#include "bezier.hpp"
+#include "math/util.hpp"
+
+namespace flatten {
+  static constexpr size_t MAX_SEGMENTS = 4096;
+
+  inline size_t segments_from_estimate(Float estimate) {
+    if (!(estimate >= 1)) return 1; // also catches NaN from degenerate input
+    return std::min(MAX_SEGMENTS, static_cast<size_t>(std::ceil(estimate)));
+  }
+
+  size_t quadratic_segments(
+      const vector2f& p0,
+      const vector2f& p1,
+      const vector2f& p2,
+      const options& opts)
+  {
+    if (opts.tolerance <= 0) return opts.n_segments;
+    const Float dd = (p0 - 2.0f * p1 + p2).size();
+    return segments_from_estimate(std::sqrt(dd / (4.0f * opts.tolerance)));
+  }
+
+  size_t cubic_segments(
+      const vector2f& p0,
+      const vector2f& p1,
+      const vector2f& p2,
+      const vector2f& p3,
+      const options& opts)
+  {
+    if (opts.tolerance <= 0) return opts.n_segments;
+    const Float dd = std::max(
+        (p0 - 2.0f * p1 + p2).size(),
+        (p1 - 2.0f * p2 + p3).size()
+        );
+    return segments_from_estimate(std::sqrt(3.0f * dd / (4.0f * opts.tolerance)));
+  }
+
+  size_t arc_segments(const bezier::elliptical_arc& arc, const options& opts) {
+    if (opts.tolerance <= 0) return opts.n_segments;
+    if (arc.is_line()) return 1;
+    // largest angle step whose sagitta on the bigger radius stays within tolerance
+    const Float r = std::max(arc.radii().x, arc.radii().y);
+    const Float max_step = 2.0f * std::acos(clamp<Float>(1.0f - opts.tolerance / r, -1, 1));
+    if (COMPARE_EQ(max_step, 0)) return MAX_SEGMENTS;
+    return segments_from_estimate(std::abs(arc.sweep_angle()) / max_step);
+  }
+
+  builder::builder(std::vector<vertex>& vertices, const options& opts)
+    : m_vertices(vertices), m_options(opts), m_marker(0, 0), m_subpath_start(0, 0) {}
+
+  void builder::begin_segment() {
+    if (!m_reopen) return;
+    m_vertices.push_back({ m_marker, true });
+    m_reopen = false;
+  }
+
+  void builder::push_samples(size_t n_samples) {
+    for (size_t i = 0; i < n_samples; ++i) {
+      m_vertices.push_back({ m_samples[i], false });
+    }
+  }
+
+  void builder::operator()(const svg::action::move_to& move_to) {
+    m_marker = move_to.dst;
+    m_subpath_start = m_marker;
+    m_reopen = false;
+    m_vertices.push_back({ m_marker, true });
+  }
+
+  void builder::operator()(const svg::action::line_to& line_to) {
+    begin_segment();
+    m_marker = line_to.dst;
+    m_vertices.push_back({ m_marker, false });
+  }
+
+  void builder::operator()(const svg::action::quadratic_bezier_to& quad_to) {
+    begin_segment();
+    const size_t n_segments = quadratic_segments(m_marker, quad_to.p1, quad_to.p2, m_options);
+    if (m_samples.size() < n_segments) m_samples.resize(n_segments);
+    bezier::quadratic_curve_samples(
+        m_marker, quad_to.p1, quad_to.p2, n_segments, m_samples.data()
+        );
+    push_samples(n_segments);
+    m_marker = quad_to.dst;
+  }
+
+  void builder::operator()(const svg::action::cubic_bezier_to& cubic_to) {
+    begin_segment();
+    const size_t n_segments
+      = cubic_segments(m_marker, cubic_to.p1, cubic_to.p2, cubic_to.p3, m_options);
+    m_cubic_offsets[m_cubics.size] = m_vertices.size();
+    m_cubics.push(m_marker, cubic_to.p1, cubic_to.p2, cubic_to.p3, n_segments);
+    m_vertices.resize(m_vertices.size() + n_segments);
+    m_marker = cubic_to.dst;
+    if (m_cubics.full()) flush_cubics();
+  }
+
+  void builder::flush_cubics() {
+    if (m_cubics.size == 0) return;
+
+    size_t n_samples = 0;
+    for (size_t lane = 0; lane < m_cubics.size; ++lane) {
+      n_samples += m_cubics.n_segments[lane];
+    }
+    if (m_samples.size() < n_samples) m_samples.resize(n_samples);
+
+    vector2f* out[bezier::cubic_batch::WIDTH];
+    for (size_t lane = 0, offset = 0; lane < m_cubics.size; ++lane) {
+      out[lane] = m_samples.data() + offset;
+      offset += m_cubics.n_segments[lane];
+    }
+    bezier::cubic_batch_samples(m_cubics, out);
+
+    for (size_t lane = 0; lane < m_cubics.size; ++lane) {
+      vertex* dst = m_vertices.data() + m_cubic_offsets[lane];
+      for (size_t i = 0; i < m_cubics.n_segments[lane]; ++i) {
+        dst[i].position = out[lane][i];
+      }
+    }
+    m_cubics.size = 0;
+  }
+
+  void builder::operator()(const svg::action::elliptic_arc_to& arc_to) {
+    begin_segment();
+    const bezier::elliptical_arc arc(
+        m_marker, arc_to.p1, arc_to.r, arc_to.large_arc, arc_to.sweep, arc_to.x_axis_rotation
+        );
+    const size_t n_segments = arc_segments(arc, m_options);
+    if (m_samples.size() < n_segments) m_samples.resize(n_segments);
+    arc.samples(n_segments, m_samples.data());
+    push_samples(n_segments);
+    m_marker = arc_to.dst;
+  }
+
+  void builder::operator()(const svg::action::close_subpath&) {
+    if (!m_vertices.empty()) m_vertices.back().closeflag = true;
+    // later segments continue from the subpath start
+    m_marker = m_subpath_start;
+    m_reopen = true;
+  }
+
+  void builder::finish() {
+    flush_cubics();
+  }
+} /* namespace flatten */
@@ -1,69 +1,227 @@
 #include <iostream>
 #include <string>
-#include <sstream>
+#include <memory>
+#include <array>
+#include <deque>
 #include <algorithm>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <cctype>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <fcntl.h>
+#include <boost/filesystem.hpp>
 
-#include "svg_reader.hpp"
-#include "bezier.hpp"
+#include "convert.hpp"
 
-const std::string SCAD_DISCLAIMER =
-"/*\n"
-" * This file is generated with svg2scad.\n"
-" * Direct modification to its contents is discouraged.\n"
-" */\n";
+using namespace convert;
 
-const std::string SCAD_PREAMBLE = "function svg_distance(p0,p1)=sqrt((p0.x-p1.x)*(p0.x-p1.x)+(p0.y-p1.y)*(p0.y-p1.y));function svg_normalize(v)=v/svg_distance(v,[0,0]);";
+// the document loaded into reader, or the chunks of svg_fpath if stream_input
+path_source document_paths(svg::reader& reader, const std::string& svg_fpath, bool stream_input) {
+  if (stream_input) {
+    return [&reader, svg_fpath](const svg::reader::chunk_handler& handler) {
+      reader.stream_file(svg_fpath, handler);
+    };
+  }
+  return [&reader](const svg::reader::chunk_handler& handler) { handler(reader.actions()); };
+}
 
-const std::string SCAD_MODULE_DRAW_LINE = "module svg_line(p0,p1,thickness,depth){size=svg_distance(p0,p1);angle=atan2(p1.y-p0.y,p1.x-p0.x);translate(p0){rotate(angle,[0,0,1]){translate([0,-0.5*thickness,0]){scale([size,thickness,depth]){cube([1,1,1]);}}}}}";
+namespace batch {
+  namespace fs = boost::filesystem;
 
-const std::string SCAD_MODULE_DRAW_VERTICES = "module svg_curve(vertices,thickness,depth){extent=0.5*thickness;n_segments=len(vertices)-1;union(){for(i=[0:n_segments-1]){p=vertices[max(0,i-1)];p0=vertices[i];p1=vertices[i+1];tangent0=p0-p;tangent1=p1-p0;normal0=svg_normalize([tangent0.y,-tangent0.x]);normal1=svg_normalize([tangent1.y,-tangent1.x]);fpr0=p0+extent*normal0;fpr1=p0+extent*normal1;fpl0=p0-extent*normal0;fpl1=p0-extent*normal1;svg_line(p0,p1,thickness,depth);color([1,0,0])linear_extrude(depth)polygon([p0,fpr0,fpr1]);color([0,1,0])linear_extrude(depth)polygon([p0,fpl0,fpl1]);}}}";
+  static const std::string NAME_PLACEHOLDER = "{name}";
 
-using namespace math;
+  // files and *.svg files directly inside directories, each directory sorted by name
+  std::vector<std::string> expand_inputs(const std::vector<std::string>& inputs) {
+    std::vector<std::string> fpaths;
+    for (const std::string& input : inputs) {
+      if (!fs::is_directory(input)) {
+        fpaths.push_back(input);
+        continue;
+      }
+      std::vector<std::string> entries;
+      for (fs::directory_iterator it(input), end; it != end; ++it) {
+        std::string extension = it->path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (extension == ".svg" && !fs::is_directory(it->status())) {
+          entries.push_back(it->path().string());
+        }
+      }
+      std::sort(entries.begin(), entries.end());
+      fpaths.insert(fpaths.end(), entries.begin(), entries.end());
+    }
+    return fpaths;
+  }
 
-void scad_print_header() {
-  std::cout << SCAD_DISCLAIMER << std::endl;
-  std::cout << SCAD_PREAMBLE << std::endl;
-  std::cout << SCAD_MODULE_DRAW_LINE << std::endl;
-  std::cout << SCAD_MODULE_DRAW_VERTICES << std::endl;
-}
+  std::string replace_name(std::string str, const std::string& name) {
+    for (size_t i = str.find(NAME_PLACEHOLDER); i != std::string::npos;
+        i = str.find(NAME_PLACEHOLDER, i + name.size()))
+    {
+      str.replace(i, NAME_PLACEHOLDER.size(), name);
+    }
+    return str;
+  }
 
-std::string scad_vertices_list(const std::vector<vector2f>& vertices) {
-  std::stringstream ss;
-  ss << "[";
-  for (size_t i = 0; i < vertices.size(); ++i) {
-    ss << "[" << vertices[i].x << "," << vertices[i].y << "]";
-    if ((i + 1) < vertices.size()) {
-      ss << ",";
+  // valid OpenSCAD identifier made from a file name
+  std::string identifier(const std::string& name) {
+    std::string id(name);
+    for (char& c : id) {
+      if (!std::isalnum(static_cast<unsigned char>(c))) c = '_';
     }
+    if (id.empty() || std::isdigit(static_cast<unsigned char>(id[0]))) id.insert(0, 1, '_');
+    return id;
   }
-  ss << "]";
-  return ss.str();
-}
 
-void scad_print_line(const vector2f& from, const vector2f& to) {
-  std::cout << "svg_line([" << from.x << "," << from.y << "],"
-    << "[" << to.x << "," << to.y << "],thickness,depth);" << std::endl;
-}
+  /*
+   * Output path for svg_fpath. Without a template the output is written next to
+   * the input, a template containing {name} is expanded with the input's stem,
+   * and any other template names the output directory.
+   */
+  std::string output_path(
+      const std::string& output_template,
+      const std::string& svg_fpath,
+      const std::string& extension)
+  {
+    const fs::path input(svg_fpath);
+    if (output_template.empty()) return fs::path(input).replace_extension(extension).string();
+    const std::string name = input.stem().string();
+    if (output_template.find(NAME_PLACEHOLDER) != std::string::npos) {
+      return replace_name(output_template, name);
+    }
+    return (fs::path(output_template) / (name + extension)).string();
+  }
 
-void scad_print_curve(const std::vector<vector2f>& vertices) {
-  if (vertices.empty()) return;
-  std::cout << "svg_curve(" << scad_vertices_list(vertices) << ",thickness,depth);" << std::endl;
-}
+  // per-thread state reused for every file a worker converts
+  struct worker {
+    svg::reader reader;
+    std::vector<flatten::vertex> vertices;
+    output::writer out;
 
-struct scad_vertex {
-  vector2f vertex;
-  bool moveflag = false;
-};
+    explicit worker(int precision)
+      : out([](const char*, size_t) {}, precision) {}
+  };
+
+  void convert(
+      worker& w,
+      const std::string& svg_fpath,
+      const std::string& output_fpath,
+      const std::string& module_name,
+      const scad_options& opts,
+      bool stream_input)
+  {
+    w.reader.set_stats(opts.stats);
+    if (!stream_input) w.reader.load_file(svg_fpath);
+
+    const fs::path output_dir = fs::path(output_fpath).parent_path();
+    if (!output_dir.empty()) fs::create_directories(output_dir);
+    const int fd = ::open(output_fpath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("cannot open " + output_fpath + ": " + std::strerror(errno));
+    }
+
+    try {
+      w.out.redirect(
+          opts.stats ? stats::counted_sink(output::fd_sink(fd), *opts.stats) : output::fd_sink(fd));
+      print_document(
+          w.out, fd, w.reader, document_paths(w.reader, svg_fpath, stream_input), module_name,
+          opts, w.vertices, nullptr);
+      w.out.flush();
+    } catch (...) {
+      w.out.discard();
+      ::close(fd);
+      throw;
+    }
+    if (::close(fd) < 0) {
+      throw std::runtime_error("cannot close " + output_fpath + ": " + std::strerror(errno));
+    }
+  }
+
+  /*
+   * Convert every input in one process. Files are queued on a pool shared by
+   * n_jobs workers, so idle workers pick up the next file while others are
+   * still busy with large ones. A failed file is reported and skipped.
+   * Returns the number of files that failed.
+   */
+  size_t run(
+      const std::vector<std::string>& inputs,
+      const std::string& output_template,
+      const std::string& module_template,
+      const scad_options& opts,
+      int precision,
+      bool stream_input,
+      size_t n_jobs)
+  {
+    const std::vector<std::string> fpaths = expand_inputs(inputs);
+    std::atomic<size_t> n_failures(0);
+    std::mutex error_mutex;
+
+    const std::string extension = format_extension(opts.format);
+
+    thread_pool pool(std::max<size_t>(1, n_jobs));
+    for (const std::string& svg_fpath : fpaths) {
+      pool.submit([&, svg_fpath] {
+        thread_local std::unique_ptr<worker> w;
+        if (!w) w.reset(new worker(precision));
+        try {
+          const std::string name = fs::path(svg_fpath).stem().string();
+          convert(
+              *w, svg_fpath, output_path(output_template, svg_fpath, extension),
+              replace_name(module_template, identifier(name)), opts, stream_input);
+        } catch (const std::exception& e) {
+          ++n_failures;
+          std::lock_guard<std::mutex> lock(error_mutex);
+          std::cerr << svg_fpath << ": " << e.what() << std::endl;
+        }
+      });
+    }
+    pool.wait();
+    return n_failures;
+  }
+} /* namespace batch */
 
 void print_help_and_exit() {
   std::cerr
     <<
-    "Usage: svg2scad [OPTIONS] SVGFILE\n\n"
+    "Usage: svg2scad [OPTIONS] SVGFILE\n"
+    "       svg2scad --batch [OPTIONS] SVGFILE|DIRECTORY...\n\n"
     "Available Options:\n"
     "\t-o, --output\tSpecify OpenSCAD output file name with extension\n"
     "\t-m, --modname\tSpecify module name to be generated. `svg_generated' will be used if"
     " this option is not specified.\n"
     "\t-s, --segments\tSpecify number of line segments for each curve\n"
+    "\t-t, --tolerance\tFlatten curves adaptively so that no segment deviates from the curve"
+    " by more than the given distance. Overrides --segments.\n"
+    "\t--polygon\tFill shapes with native polygon() geometry, honoring fill-rule, and"
+    " outline strokes, honoring stroke-width, stroke-linejoin, stroke-linecap and"
+    " stroke-miterlimit. All of it is extruded once instead of tracing outlines with"
+    " svg_curve, which is much faster to render.\n"
+    "\t-w, --stroke-width\tOutline every shape with the given width in place of its own"
+    " stroke. Implies --polygon.\n"
+    "\t--simplify\tDrop flattened points that lie within the given distance of a"
+    " simplified outline (Ramer-Douglas-Peucker), e.g. for traced bitmaps and map data.\n"
+    "\t--dedupe\tPrint every distinct subpath, or shape with --polygon, once as a module"
+    " and place its copies with translate(), which shrinks icon sheets and maps that repeat"
+    " the same symbol. Subpaths are then formatted on one thread.\n"
+    "\t-f, --format\tWrite `scad' (default), or triangulate and extrude the shapes as"
+    " with --polygon into a binary `stl' or a `3mf' file directly, without OpenSCAD."
+    " Binary STL not written to a regular file is held in memory until complete.\n"
+    "\t-d, --depth\tSpecify extrusion depth of stl and 3mf output. Default is 1.\n"
+    "\t-p, --precision\tSpecify number of significant digits of output coordinates."
+    " 0 prints the shortest form that reads back exactly. Default is 6.\n"
+    "\t--stream\tRead the SVG file in chunks of top-level elements and write output as it"
+    " goes, keeping memory use bounded for very large files\n"
+    "\t-j, --jobs\tSpecify number of threads used to flatten and format subpaths."
+    " Output does not depend on it.\n"
+    "\t--stats\tPrint time spent in every stage of the conversion, counts of elements,"
+    " commands and vertices, bytes written and peak memory use to standard error\n"
+    "\t--stats-json\tLike --stats, as a single JSON object\n"
+    "\t-b, --batch\tConvert every given file and every *.svg file in the given directories"
+    " in one process. --output then names the output directory, or is a template in which"
+    " {name} is replaced by the input file name without extension. Outputs are written next"
+    " to their inputs by default. {name} may also be used in --modname. --jobs files are"
+    " converted at a time.\n"
     "\t-h, --help\tPrint this help text and exit with failure\n"
     << std::endl;
   std::exit(EXIT_FAILURE);
@@ -74,10 +232,16 @@ int main(int argc, char** argv) {
     print_help_and_exit();
   }
 
-  size_t n_segments = 10;
+  scad_options opts;
+  int precision = 6;
+  size_t n_jobs = 1;
+  bool stream_input = false;
+  bool batch_mode = false;
+  bool print_stats = false;
+  bool stats_json = false;
   std::string output_fpath("");
-  std::string module_name("svg_generated");
-  std::string svg_fpath("");
+  std::string module_name(DEFAULT_MODULE_NAME);
+  std::vector<std::string> inputs;
   for (int i = 1; i < argc; ++i) {
     if (!strcmp(argv[i], "-o") || !strcmp(argv[i], "--output")) {
       if (i + 1 >= argc) print_help_and_exit();
@@ -89,115 +253,131 @@ int main(int argc, char** argv) {
       ++i;
     } else if (!strcmp(argv[i], "-s") || !strcmp(argv[i], "--segments")) {
       if (i + 1 >= argc) print_help_and_exit();
-      n_segments = atoi(argv[i+1]);
+      opts.flatten.n_segments = atoi(argv[i+1]);
+      ++i;
+    } else if (!strcmp(argv[i], "-t") || !strcmp(argv[i], "--tolerance")) {
+      if (i + 1 >= argc) print_help_and_exit();
+      opts.flatten.tolerance = atof(argv[i+1]);
+      ++i;
+    } else if (!strcmp(argv[i], "-p") || !strcmp(argv[i], "--precision")) {
+      if (i + 1 >= argc) print_help_and_exit();
+      precision = atoi(argv[i+1]);
+      ++i;
+    } else if (!strcmp(argv[i], "-j") || !strcmp(argv[i], "--jobs")) {
+      if (i + 1 >= argc) print_help_and_exit();
+      n_jobs = atoi(argv[i+1]);
+      ++i;
+    } else if (!strcmp(argv[i], "--simplify")) {
+      if (i + 1 >= argc) print_help_and_exit();
+      opts.simplify_tolerance = atof(argv[i+1]);
+      ++i;
+    } else if (!strcmp(argv[i], "--dedupe")) {
+      opts.dedupe = true;
+    } else if (!strcmp(argv[i], "-f") || !strcmp(argv[i], "--format")) {
+      if (i + 1 >= argc) print_help_and_exit();
+      if (!strcmp(argv[i+1], "scad")) {
+        opts.format = FORMAT_SCAD;
+      } else if (!strcmp(argv[i+1], "stl")) {
+        opts.format = FORMAT_STL;
+      } else if (!strcmp(argv[i+1], "3mf")) {
+        opts.format = FORMAT_3MF;
+      } else {
+        print_help_and_exit();
+      }
+      ++i;
+    } else if (!strcmp(argv[i], "-d") || !strcmp(argv[i], "--depth")) {
+      if (i + 1 >= argc) print_help_and_exit();
+      opts.depth = atof(argv[i+1]);
       ++i;
+    } else if (!strcmp(argv[i], "--polygon")) {
+      opts.polygons = true;
+    } else if (!strcmp(argv[i], "-w") || !strcmp(argv[i], "--stroke-width")) {
+      if (i + 1 >= argc) print_help_and_exit();
+      opts.stroke_width = atof(argv[i+1]);
+      opts.polygons = true;
+      ++i;
+    } else if (!strcmp(argv[i], "--stream")) {
+      stream_input = true;
+    } else if (!strcmp(argv[i], "--stats")) {
+      print_stats = true;
+    } else if (!strcmp(argv[i], "--stats-json")) {
+      print_stats = true;
+      stats_json = true;
+    } else if (!strcmp(argv[i], "-b") || !strcmp(argv[i], "--batch")) {
+      batch_mode = true;
     } else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
       print_help_and_exit();
     } else {
-      svg_fpath = argv[i];
+      inputs.push_back(argv[i]);
     }
   }
 
-  n_segments = std::max(1ul, n_segments);
+  opts.flatten.n_segments = std::max(1ul, opts.flatten.n_segments);
 
-  svg::reader svg_reader;
-  try {
-    svg_reader.load_file(svg_fpath);
-  } catch (const std::exception& e) {
-    std::cerr << e.what() << std::endl;
-    return EXIT_FAILURE;
+  std::unique_ptr<stats::counters> counters;
+  if (print_stats) {
+    counters.reset(new stats::counters());
+    opts.stats = counters.get();
   }
+  auto report_stats = [&] {
+    if (!counters) return;
+    output::writer stats_out(STDERR_FILENO);
+    if (stats_json) counters->print_json(stats_out);
+    else counters->print(stats_out);
+  };
 
-  if (!output_fpath.empty()) {
-    std::freopen(output_fpath.c_str(), "w", stdout);
+  if (batch_mode) {
+    try {
+      const size_t n_failures = batch::run(
+          inputs, output_fpath, module_name, opts, precision, stream_input, n_jobs);
+      report_stats();
+      return n_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
   }
 
-  vector2f marker(0, 0);
-  std::vector<scad_vertex> scad_vertices;
-  scad_print_header();
-
-  for (const auto& action : svg_reader.actions()) {
-    auto action_type = svg::action::get_type(action);
-    switch (action_type) {
-      case svg::action::ACTION_MOVE_TO:
-        {
-          const auto& move_to = std::dynamic_pointer_cast<const svg::action::move_to>(action);
-          marker = move_to->dst;
-          scad_vertices.push_back({ marker, true });
-          break;
-        }
-      case svg::action::ACTION_LINE_TO:
-        {
-          const auto& line_to = std::dynamic_pointer_cast<const svg::action::line_to>(action);
-          marker = line_to->dst;
-          scad_vertices.push_back({ marker, false });
-          break;
-        }
-      case svg::action::ACTION_QUAD_BEZIER_TO:
-        {
-          const auto& quad_to
-            = std::dynamic_pointer_cast<const svg::action::quadratic_bezier_to>(action);
-          for (size_t i = 1; i <= n_segments; ++i) {
-            float t = (float) i / n_segments;
-            scad_vertices.push_back(
-                { bezier::quadratic_curve(marker, quad_to->p1, quad_to->p2, t), false }
-                );
-          }
-          marker = quad_to->dst;
-          break;
-        }
-      case svg::action::ACTION_CUBIC_BEZIER_TO:
-        {
-          const auto& cubic_to
-            = std::dynamic_pointer_cast<const svg::action::cubic_bezier_to>(action);
-          for (size_t i = 1; i <= n_segments; ++i) {
-            float t = (float) i / n_segments;
-            scad_vertices.push_back(
-                { bezier::cubic_curve(marker, cubic_to->p1, cubic_to->p2, cubic_to->p3, t), false }
-                );
-          }
-          marker = cubic_to->dst;
-          break;
-        }
-      case svg::action::ACTION_ELLIPTIC_ARC_TO:
-        {
-          const auto& arc_to
-            = std::dynamic_pointer_cast<const svg::action::elliptic_arc_to>(action);
-          for (size_t i = 1; i <= n_segments; ++i) {
-            float t = (float) i / n_segments;
-            scad_vertices.push_back(
-                { bezier::elliptical_curve(
-                    marker,
-                    arc_to->p1,
-                    arc_to->r,
-                    arc_to->large_arc,
-                    arc_to->sweep,
-                    arc_to->x_axis_rotation,
-                    t
-                    ), false }
-                );
-          }
-          marker = arc_to->dst;
-          break;
-        }
-      default:
-        std::cerr << "error: unknown SVG action" << std::endl;
-        return EXIT_FAILURE;
-    }
-  } /* for action */
+  const std::string svg_fpath = inputs.empty() ? "" : inputs.back();
 
-  std::cout << "module " << module_name << "(thickness=1,depth=1) {" << std::endl;
+  svg::reader svg_reader;
+  svg_reader.set_stats(opts.stats);
+  if (!stream_input) {
+    try {
+      svg_reader.load_file(svg_fpath);
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
 
-  std::vector<vector2f> curve_vertices;
-  for (size_t i = 0; i < scad_vertices.size(); ++i) {
-    while (i < scad_vertices.size() && !scad_vertices[i].moveflag) {
-      curve_vertices.push_back(scad_vertices[i++].vertex);
+  std::unique_ptr<output::writer> out;
+  try {
+    if (output_fpath.empty()) {
+      out.reset(new output::writer(STDOUT_FILENO, precision));
+    } else {
+      out.reset(new output::writer(output_fpath, precision));
     }
-    scad_print_curve(curve_vertices);
-    curve_vertices.clear();
+    if (counters) out->redirect(stats::counted_sink(output::fd_sink(out->fd()), *counters));
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
   }
 
-  std::cout << "}" << std::endl;
+  std::unique_ptr<thread_pool> pool;
+  if (n_jobs > 1) pool.reset(new thread_pool(n_jobs));
+
+  std::vector<flatten::vertex> scad_vertices;
+  try {
+    print_document(
+        *out, out->fd(), svg_reader, document_paths(svg_reader, svg_fpath, stream_input),
+        module_name, opts, scad_vertices, pool.get());
+    out->flush();
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  report_stats();
 
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,66 @@
+#include "mapped_file.hpp"
+
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace input {
+  inline std::runtime_error file_error(const std::string& what, const std::string& fpath) {
+    return std::runtime_error(what + " " + fpath + ": " + std::strerror(errno));
+  }
+
+  mapped_file::mapped_file(const std::string& fpath) {
+    const int fd = ::open(fpath.c_str(), O_RDONLY);
+    if (fd < 0) throw file_error("cannot open file", fpath);
+
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+      ::close(fd);
+      throw file_error("cannot stat file", fpath);
+    }
+    m_size = st.st_size;
+
+    // reserve zeroed anonymous pages for the file plus its terminating zero,
+    // then map the file over the front of the reservation
+    const size_t page_size = ::sysconf(_SC_PAGESIZE);
+    m_mapped_size = (m_size / page_size + 1) * page_size;
+    void* base = ::mmap(
+        nullptr, m_mapped_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+        );
+    if (base == MAP_FAILED) {
+      ::close(fd);
+      throw file_error("cannot map file", fpath);
+    }
+
+    if (m_size > 0) {
+      void* mapped = ::mmap(
+          base, m_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0
+          );
+      if (mapped == MAP_FAILED) {
+        ::munmap(base, m_mapped_size);
+        ::close(fd);
+        throw file_error("cannot map file", fpath);
+      }
+      ::madvise(mapped, m_size, MADV_SEQUENTIAL);
+    }
+    ::close(fd);
+
+    m_data = static_cast<char*>(base);
+  }
+
+  mapped_file::~mapped_file() {
+    if (m_data) ::munmap(m_data, m_mapped_size);
+  }
+
+  const char* mapped_file::data() const {
+    return m_data;
+  }
+
+  size_t mapped_file::size() const {
+    return m_size;
+  }
+} /* namespace input */
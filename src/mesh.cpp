@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <limits>
+
+#include "mesh.hpp"
+
+namespace mesh {
+  static constexpr size_t NO_RING = std::numeric_limits<size_t>::max();
+
+  // z component of (b - a) x (c - b), positive if a, b, c turn counterclockwise
+  inline double turn(const vector2f& a, const vector2f& b, const vector2f& c) {
+    return static_cast<double>(b.x - a.x) * (c.y - b.y)
+      - static_cast<double>(b.y - a.y) * (c.x - b.x);
+  }
+
+  inline bool same_position(const vector2f& a, const vector2f& b) {
+    return a.x == b.x && a.y == b.y;
+  }
+
+  // whether p lies inside or on the boundary of triangle abc, in either orientation
+  inline bool in_triangle(
+      const vector2f& p,
+      const vector2f& a,
+      const vector2f& b,
+      const vector2f& c)
+  {
+    const double ab = turn(a, b, p), bc = turn(b, c, p), ca = turn(c, a, p);
+    return (ab >= 0 && bc >= 0 && ca >= 0) || (ab <= 0 && bc <= 0 && ca <= 0);
+  }
+
+  // even-odd containment of p in the ring [first, last)
+  inline bool ring_contains(const vector2f* first, const vector2f* last, const vector2f& p) {
+    bool inside = false;
+    const vector2f* a = last - 1;
+    for (const vector2f* b = first; b != last; a = b++) {
+      if ((a->y > p.y) == (b->y > p.y)) continue;
+      const double x = a->x + static_cast<double>(p.y - a->y) * (b->x - a->x) / (b->y - a->y);
+      if (p.x < x) inside = !inside;
+    }
+    return inside;
+  }
+
+  // depth counts the rings around each ring, so even depths are outer rings
+  void triangulator::classify(const vector2f* points) {
+    auto contains = [points](const ring_info& outer, const vector2f& p) {
+      return p.x >= outer.min.x && p.x <= outer.max.x && p.y >= outer.min.y && p.y <= outer.max.y
+        && ring_contains(points + outer.first, points + outer.last, p);
+    };
+
+    for (ring_info& ring : m_rings) {
+      const vector2f& p = points[ring.first];
+      ring.depth = 0;
+      for (const ring_info& other : m_rings) {
+        if (&other != &ring && contains(other, p)) ++ring.depth;
+      }
+    }
+    // a hole belongs to the smallest outer ring one level up that contains it
+    for (ring_info& ring : m_rings) {
+      ring.parent = NO_RING;
+      if (ring.depth % 2 == 0) continue;
+      const vector2f& p = points[ring.first];
+      for (size_t i = 0; i < m_rings.size(); ++i) {
+        const ring_info& other = m_rings[i];
+        if (other.depth + 1 != ring.depth || !contains(other, p)) continue;
+        if (ring.parent == NO_RING
+            || std::abs(other.area) < std::abs(m_rings[ring.parent].area))
+        {
+          ring.parent = i;
+        }
+      }
+    }
+  }
+
+  // append the ring to the solid, leaving out repeated points
+  void triangulator::add_ring(const vector2f* points, const ring_info& ring, bool reverse) {
+    const size_t first = m_solid.points.size();
+    for (size_t k = 0; k < ring.last - ring.first; ++k) {
+      const vector2f& p = points[reverse ? ring.last - 1 - k : ring.first + k];
+      if (m_solid.points.size() == first || !same_position(p, m_solid.points.back())) {
+        m_solid.points.push_back(p);
+      }
+    }
+    while (m_solid.points.size() - first > 1
+        && same_position(m_solid.points.back(), m_solid.points[first]))
+    {
+      m_solid.points.pop_back();
+    }
+    m_solid.ring_ends.push_back(m_solid.points.size());
+  }
+
+  /*
+   * Join the hole at solid points [first, last) to m_polygon by a pair of
+   * coincident edges between the hole's rightmost vertex m and a polygon
+   * vertex visible from it (Eberly, "Triangulation by Ear Clipping"). Returns
+   * false, leaving m_polygon alone, if the hole is not inside it.
+   */
+  bool triangulator::bridge_hole(size_t first, size_t last) {
+    const std::vector<vector2f>& points = m_solid.points;
+    size_t m = first;
+    for (size_t i = first + 1; i < last; ++i) {
+      if (points[i].x > points[m].x) m = i;
+    }
+    const vector2f& mp = points[m];
+
+    // nearest polygon edge hit by a ray from m towards +x
+    const size_t n = m_polygon.size();
+    double hit_x = std::numeric_limits<double>::infinity();
+    size_t visible = NO_RING;
+    for (size_t k = 0; k < n; ++k) {
+      const vector2f& a = points[m_polygon[k]];
+      const vector2f& b = points[m_polygon[(k + 1) % n]];
+      if ((a.y > mp.y) == (b.y > mp.y)) continue;
+      const double x = a.x + static_cast<double>(mp.y - a.y) * (b.x - a.x) / (b.y - a.y);
+      if (x < mp.x || x >= hit_x) continue;
+      hit_x = x;
+      visible = a.x > b.x ? k : (k + 1) % n;
+    }
+    if (visible == NO_RING) return false; // not inside the polygon after all
+
+    // a reflex vertex inside triangle (m, hit, visible) would block the bridge;
+    // the one closest in angle to the ray is visible instead
+    const vector2f hit(static_cast<Float>(hit_x), mp.y);
+    const vector2f vp = points[m_polygon[visible]];
+    if (!same_position(vp, hit)) {
+      double best_slope = std::numeric_limits<double>::infinity();
+      double best_distance = std::numeric_limits<double>::infinity();
+      for (size_t k = 0; k < n; ++k) {
+        const vector2f& p = points[m_polygon[k]];
+        if (p.x <= mp.x || same_position(p, vp) || !in_triangle(p, mp, hit, vp)) continue;
+        const vector2f& prev = points[m_polygon[(k + n - 1) % n]];
+        const vector2f& next = points[m_polygon[(k + 1) % n]];
+        if (turn(prev, p, next) > 0) continue;
+        const double slope = std::abs(static_cast<double>(p.y - mp.y)) / (p.x - mp.x);
+        const double distance = static_cast<double>(p.x - mp.x) * (p.x - mp.x)
+          + static_cast<double>(p.y - mp.y) * (p.y - mp.y);
+        if (slope < best_slope || (slope == best_slope && distance < best_distance)) {
+          best_slope = slope;
+          best_distance = distance;
+          visible = k;
+        }
+      }
+    }
+
+    // visible, m, the rest of the hole, m again, then back to visible
+    std::vector<uint32_t> splice;
+    splice.reserve(last - first + 2);
+    for (size_t i = m; i < last; ++i) splice.push_back(i);
+    for (size_t i = first; i <= m; ++i) splice.push_back(i);
+    splice.push_back(m_polygon[visible]);
+    m_polygon.insert(m_polygon.begin() + visible + 1, splice.begin(), splice.end());
+    return true;
+  }
+
+  // cut off ears of m_polygon until it is used up, adding top and bottom triangles
+  void triangulator::clip_ears() {
+    const std::vector<vector2f>& points = m_solid.points;
+    const uint32_t n_points = points.size();
+    const uint32_t n = m_polygon.size();
+    m_prev.resize(n);
+    m_next.resize(n);
+    m_removed.assign(n, false);
+    for (uint32_t i = 0; i < n; ++i) {
+      m_prev[i] = i == 0 ? n - 1 : i - 1;
+      m_next[i] = i + 1 == n ? 0 : i + 1;
+    }
+    auto position = [&](uint32_t node) -> const vector2f& { return points[m_polygon[node]]; };
+    auto corner_turn = [&](uint32_t node) {
+      return turn(position(m_prev[node]), position(node), position(m_next[node]));
+    };
+    auto remove = [&](uint32_t node) {
+      m_next[m_prev[node]] = m_next[node];
+      m_prev[m_next[node]] = m_prev[node];
+      m_removed[node] = true;
+    };
+    auto add_triangle = [&](uint32_t a, uint32_t b, uint32_t c) {
+      const uint32_t pa = m_polygon[a], pb = m_polygon[b], pc = m_polygon[c];
+      m_solid.triangles.push_back({{ pa, pc, pb }});
+      m_solid.triangles.push_back({{ pa + n_points, pb + n_points, pc + n_points }});
+    };
+
+    // only reflex vertices can lie inside an ear, and clipping never makes a convex one reflex
+    m_reflex.clear();
+    for (uint32_t i = 0; i < n; ++i) {
+      if (corner_turn(i) <= 0) m_reflex.push_back(i);
+    }
+    auto is_ear = [&](uint32_t node) {
+      const uint32_t prev = m_prev[node], next = m_next[node];
+      const vector2f& a = position(prev);
+      const vector2f& b = position(node);
+      const vector2f& c = position(next);
+      for (const uint32_t r : m_reflex) {
+        if (m_removed[r] || r == prev || r == node || r == next) continue;
+        const vector2f& p = position(r);
+        if (same_position(p, a) || same_position(p, b) || same_position(p, c)) continue;
+        if (in_triangle(p, a, b, c) && corner_turn(r) <= 0) return false;
+      }
+      return true;
+    };
+
+    uint32_t remaining = n, node = 0, n_stalled = 0, compacted = n;
+    while (remaining > 3) {
+      if (2 * remaining < compacted) {
+        m_reflex.erase(std::remove_if(m_reflex.begin(), m_reflex.end(),
+              [&](uint32_t r) { return m_removed[r] || corner_turn(r) > 0; }), m_reflex.end());
+        compacted = remaining;
+      }
+
+      // corners without area are clipped too, since leaving them out of the
+      // caps would not match the walls; when no ear is left because the input
+      // intersects itself, one is clipped anyway
+      const double t = corner_turn(node);
+      if (t == 0 || n_stalled > remaining || (t > 0 && is_ear(node))) {
+        add_triangle(m_prev[node], node, m_next[node]);
+        const uint32_t next = m_next[node];
+        remove(node);
+        --remaining;
+        node = next;
+        n_stalled = 0;
+      } else {
+        node = m_next[node];
+        ++n_stalled;
+      }
+    }
+    add_triangle(m_prev[node], node, m_next[node]);
+  }
+
+  // two triangles per ring edge, facing away from the solid
+  void triangulator::add_walls() {
+    const uint32_t n = m_solid.points.size();
+    uint32_t first = 0;
+    for (const size_t ring_end : m_solid.ring_ends) {
+      const uint32_t last = ring_end;
+      for (uint32_t i = first; i < last; ++i) {
+        const uint32_t j = i + 1 == last ? first : i + 1;
+        m_solid.triangles.push_back({{ i, j, j + n }});
+        m_solid.triangles.push_back({{ i, j + n, i + n }});
+      }
+      first = last;
+    }
+  }
+
+  void triangulator::operator()(
+      const vector2f* points,
+      const size_t* ring_ends,
+      size_t n_rings,
+      const solid_sink& emit)
+  {
+    m_rings.clear();
+    size_t first = 0;
+    for (size_t i = 0; i < n_rings; first = ring_ends[i++]) {
+      ring_info ring;
+      ring.first = first;
+      ring.last = ring_ends[i];
+      if (ring.last - ring.first < 3) continue;
+      ring.area = 0;
+      ring.min = ring.max = points[first];
+      const vector2f* prev = points + ring.last - 1;
+      for (const vector2f* p = points + ring.first; p != points + ring.last; prev = p++) {
+        ring.area += static_cast<double>(prev->x) * p->y - static_cast<double>(p->x) * prev->y;
+        ring.min = vector2f(std::min(ring.min.x, p->x), std::min(ring.min.y, p->y));
+        ring.max = vector2f(std::max(ring.max.x, p->x), std::max(ring.max.y, p->y));
+      }
+      if (ring.area != 0) m_rings.push_back(ring);
+    }
+    classify(points);
+
+    for (size_t i = 0; i < m_rings.size(); ++i) {
+      const ring_info& outer = m_rings[i];
+      if (outer.depth % 2 != 0) continue;
+
+      m_solid.points.clear();
+      m_solid.ring_ends.clear();
+      m_solid.triangles.clear();
+      add_ring(points, outer, outer.area < 0);
+      m_polygon.resize(m_solid.points.size());
+      for (size_t k = 0; k < m_polygon.size(); ++k) m_polygon[k] = k;
+
+      // bridging from right to left keeps earlier bridges out of the way
+      m_holes.clear();
+      for (size_t j = 0; j < m_rings.size(); ++j) {
+        if (m_rings[j].parent == i) m_holes.push_back(j);
+      }
+      std::sort(m_holes.begin(), m_holes.end(),
+          [this](size_t a, size_t b) { return m_rings[a].max.x > m_rings[b].max.x; });
+      for (const size_t j : m_holes) {
+        const size_t hole_first = m_solid.points.size();
+        add_ring(points, m_rings[j], m_rings[j].area > 0);
+        if (!bridge_hole(hole_first, m_solid.points.size())) {
+          m_solid.points.resize(hole_first);
+          m_solid.ring_ends.pop_back();
+        }
+      }
+
+      clip_ears();
+      add_walls();
+      emit(m_solid);
+    }
+  }
+} /* namespace mesh */
@@ -0,0 +1,323 @@
+#include "mesh_writer.hpp"
+
+#include <array>
+#include <limits>
+#include <algorithm>
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace mesh {
+  static constexpr size_t STL_HEADER_SIZE = 80;
+  static constexpr size_t STL_TRIANGLE_SIZE = 50;
+  static const char STL_HEADER[] = "binary STL generated with svg2scad";
+
+  static const char THREEMF_CONTENT_TYPES[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<Types xmlns=\"http://schemas.openxmlformats.org/package/2006/content-types\">"
+    "<Default Extension=\"rels\""
+    " ContentType=\"application/vnd.openxmlformats-package.relationships+xml\"/>"
+    "<Default Extension=\"model\""
+    " ContentType=\"application/vnd.ms-package.3dmanufacturing-3dmodel+xml\"/>"
+    "</Types>\n";
+
+  static const char THREEMF_RELATIONSHIPS[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<Relationships xmlns=\"http://schemas.openxmlformats.org/package/2006/relationships\">"
+    "<Relationship Target=\"/3D/3dmodel.model\" Id=\"rel0\""
+    " Type=\"http://schemas.microsoft.com/3dmanufacturing/2013/01/3dmodel\"/>"
+    "</Relationships>\n";
+
+  static const char THREEMF_MODEL_BEGIN[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<model unit=\"millimeter\" xml:lang=\"en-US\""
+    " xmlns=\"http://schemas.microsoft.com/3dmanufacturing/core/2015/02\">\n"
+    "<resources>\n";
+
+  // file formats are little endian whatever the host is
+  inline char* put_le(char* p, uint64_t value, size_t n_bytes) {
+    for (size_t i = 0; i < n_bytes; ++i, value >>= 8) *p++ = static_cast<char>(value & 0xff);
+    return p;
+  }
+
+  inline char* put_float(char* p, Float value) {
+    const float f = static_cast<float>(value);
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return put_le(p, bits, 4);
+  }
+
+  stl_exporter::stl_exporter(output::writer& out, int fd, Float depth)
+    : m_out(out), m_fd(fd), m_depth(depth)
+  {
+    m_start = m_fd < 0 ? -1 : ::lseek(m_fd, 0, SEEK_CUR);
+    m_buffered = m_start < 0;
+    if (!m_buffered) {
+      m_out.flush();
+      write_header();
+    }
+  }
+
+  void stl_exporter::write_header() {
+    char header[STL_HEADER_SIZE + 4];
+    std::memset(header, ' ', STL_HEADER_SIZE);
+    std::memcpy(header, STL_HEADER, sizeof(STL_HEADER) - 1);
+    put_le(header + STL_HEADER_SIZE, std::min<uint64_t>(m_n_triangles, UINT32_MAX), 4);
+    m_out.write(header, sizeof(header));
+  }
+
+  void stl_exporter::add(const solid& s) {
+    const size_t n = s.points.size();
+    auto vertex = [&](uint32_t i) {
+      return vector3f(s.points[i % n].x, s.points[i % n].y, i < n ? 0 : m_depth);
+    };
+
+    char record[STL_TRIANGLE_SIZE];
+    for (const triangle& t : s.triangles) {
+      const vector3f a = vertex(t[0]), b = vertex(t[1]), c = vertex(t[2]);
+      vector3f normal = (b - a).cross(c - a);
+      const Float length = normal.size();
+      if (length > 0) normal = normal / length;
+      char* p = record;
+      for (const vector3f& v : { normal, a, b, c }) {
+        p = put_float(p, v.x);
+        p = put_float(p, v.y);
+        p = put_float(p, v.z);
+      }
+      put_le(p, 0, 2);
+      if (m_buffered) m_triangles.append(record, sizeof(record));
+      else m_out.write(record, sizeof(record));
+    }
+    m_n_triangles += s.triangles.size();
+  }
+
+  void stl_exporter::finish() {
+    if (m_n_triangles > std::numeric_limits<uint32_t>::max()) {
+      throw std::runtime_error("too many triangles for binary STL");
+    }
+    if (m_buffered) {
+      write_header();
+      m_out.write(m_triangles.data(), m_triangles.size());
+      m_out.flush();
+      return;
+    }
+    m_out.flush();
+    char count[4];
+    put_le(count, m_n_triangles, 4);
+    if (::pwrite(m_fd, count, sizeof(count), m_start + STL_HEADER_SIZE) != sizeof(count)) {
+      throw std::runtime_error(std::string("write failed: ") + std::strerror(errno));
+    }
+  }
+
+  /*
+   * Zip archive of stored entries, written strictly in order. Sizes and CRCs
+   * follow each entry in a data descriptor, so nothing has to be known up
+   * front. ZIP64 is not supported, limiting archives to 4 GiB.
+   */
+  class zip_writer {
+    private:
+      struct entry {
+        std::string name;
+        uint32_t crc;
+        uint32_t size;
+        uint32_t offset;
+      };
+
+      static constexpr uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+      static constexpr uint32_t DATA_DESCRIPTOR_SIGNATURE = 0x08074b50;
+      static constexpr uint32_t CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+      static constexpr uint32_t END_SIGNATURE = 0x06054b50;
+      static constexpr uint32_t VERSION = 20;
+      static constexpr uint32_t FLAG_DATA_DESCRIPTOR = 1 << 3;
+      static constexpr uint32_t DATE_1980_01_01 = (1 << 5) | 1;
+
+      output::writer& m_out;
+      std::vector<entry> m_entries;
+      uint64_t m_offset = 0;
+      uint32_t m_crc = 0;
+      uint64_t m_size = 0;
+
+      static const std::array<uint32_t, 256>& crc_table() {
+        static const std::array<uint32_t, 256> table = [] {
+          std::array<uint32_t, 256> t;
+          for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            t[i] = c;
+          }
+          return t;
+        }();
+        return table;
+      }
+
+      static uint32_t checked(uint64_t value) {
+        if (value > std::numeric_limits<uint32_t>::max()) {
+          throw std::runtime_error("3MF package exceeds 4 GiB");
+        }
+        return static_cast<uint32_t>(value);
+      }
+
+      void put(const char* data, size_t n) {
+        m_out.write(data, n);
+        m_offset += n;
+      }
+
+    public:
+      explicit zip_writer(output::writer& out) : m_out(out) {}
+
+      void begin_entry(const std::string& name) {
+        m_entries.push_back({ name, 0, 0, checked(m_offset) });
+        m_crc = 0xffffffff;
+        m_size = 0;
+
+        char header[30];
+        char* p = put_le(header, LOCAL_HEADER_SIGNATURE, 4);
+        p = put_le(p, VERSION, 2);
+        p = put_le(p, FLAG_DATA_DESCRIPTOR, 2);
+        p = put_le(p, 0, 2); // stored
+        p = put_le(p, 0, 2); // time
+        p = put_le(p, DATE_1980_01_01, 2);
+        p = put_le(p, 0, 12); // crc and sizes, in the data descriptor
+        p = put_le(p, name.size(), 2);
+        put_le(p, 0, 2);
+        put(header, sizeof(header));
+        put(name.data(), name.size());
+      }
+
+      void write(const char* data, size_t n) {
+        const std::array<uint32_t, 256>& table = crc_table();
+        uint32_t crc = m_crc;
+        for (size_t i = 0; i < n; ++i) {
+          crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xff] ^ (crc >> 8);
+        }
+        m_crc = crc;
+        m_size += n;
+        put(data, n);
+      }
+
+      void end_entry() {
+        entry& e = m_entries.back();
+        e.crc = m_crc ^ 0xffffffff;
+        e.size = checked(m_size);
+
+        char descriptor[16];
+        char* p = put_le(descriptor, DATA_DESCRIPTOR_SIGNATURE, 4);
+        p = put_le(p, e.crc, 4);
+        p = put_le(p, e.size, 4);
+        put_le(p, e.size, 4);
+        put(descriptor, sizeof(descriptor));
+      }
+
+      void finish() {
+        const uint64_t directory_offset = m_offset;
+        for (const entry& e : m_entries) {
+          char header[46];
+          char* p = put_le(header, CENTRAL_HEADER_SIGNATURE, 4);
+          p = put_le(p, VERSION, 2); // made by
+          p = put_le(p, VERSION, 2); // needed
+          p = put_le(p, FLAG_DATA_DESCRIPTOR, 2);
+          p = put_le(p, 0, 2); // stored
+          p = put_le(p, 0, 2); // time
+          p = put_le(p, DATE_1980_01_01, 2);
+          p = put_le(p, e.crc, 4);
+          p = put_le(p, e.size, 4);
+          p = put_le(p, e.size, 4);
+          p = put_le(p, e.name.size(), 2);
+          p = put_le(p, 0, 8); // extra and comment lengths, disk, internal attributes
+          p = put_le(p, 0, 4); // external attributes
+          put_le(p, e.offset, 4);
+          put(header, sizeof(header));
+          put(e.name.data(), e.name.size());
+        }
+
+        char end[22];
+        char* p = put_le(end, END_SIGNATURE, 4);
+        p = put_le(p, 0, 4); // disks
+        p = put_le(p, m_entries.size(), 2);
+        p = put_le(p, m_entries.size(), 2);
+        p = put_le(p, checked(m_offset - directory_offset), 4);
+        p = put_le(p, checked(directory_offset), 4);
+        put_le(p, 0, 2);
+        put(end, sizeof(end));
+      }
+  }; /* class zip_writer */
+
+  threemf_exporter::threemf_exporter(output::writer& out, Float depth)
+    : m_zip(new zip_writer(out)),
+    m_model([this](const char* data, size_t n) { m_zip->write(data, n); }, out.precision()),
+    m_depth(depth)
+  {
+    m_zip->begin_entry("[Content_Types].xml");
+    m_zip->write(THREEMF_CONTENT_TYPES, sizeof(THREEMF_CONTENT_TYPES) - 1);
+    m_zip->end_entry();
+    m_zip->begin_entry("_rels/.rels");
+    m_zip->write(THREEMF_RELATIONSHIPS, sizeof(THREEMF_RELATIONSHIPS) - 1);
+    m_zip->end_entry();
+    m_zip->begin_entry("3D/3dmodel.model");
+    m_model << THREEMF_MODEL_BEGIN;
+  }
+
+  threemf_exporter::~threemf_exporter() {
+    // whatever is left belongs to an abandoned package
+    m_model.discard();
+  }
+
+  void threemf_exporter::add(const solid& s) {
+    char index[24];
+    auto put_index = [&](uint32_t i) {
+      m_model.write(index, std::snprintf(index, sizeof(index), "%u", i));
+    };
+
+    m_model << "<object id=\"";
+    put_index(++m_n_objects);
+    m_model << "\" type=\"model\"><mesh><vertices>\n";
+    for (const Float z : { static_cast<Float>(0), m_depth }) {
+      for (const vector2f& p : s.points) {
+        m_model << "<vertex x=\"" << p.x << "\" y=\"" << p.y << "\" z=\"" << z << "\"/>\n";
+      }
+    }
+    m_model << "</vertices><triangles>\n";
+    for (const triangle& t : s.triangles) {
+      m_model << "<triangle v1=\"";
+      put_index(t[0]);
+      m_model << "\" v2=\"";
+      put_index(t[1]);
+      m_model << "\" v3=\"";
+      put_index(t[2]);
+      m_model << "\"/>\n";
+    }
+    m_model << "</triangles></mesh></object>\n";
+  }
+
+  void threemf_exporter::finish() {
+    char index[24];
+    auto put_index = [&](size_t i) {
+      m_model.write(index, std::snprintf(index, sizeof(index), "%zu", i));
+    };
+
+    if (m_n_objects > 0) {
+      m_model << "<object id=\"";
+      put_index(m_n_objects + 1);
+      m_model << "\" type=\"model\"><components>\n";
+      for (size_t i = 1; i <= m_n_objects; ++i) {
+        m_model << "<component objectid=\"";
+        put_index(i);
+        m_model << "\"/>\n";
+      }
+      m_model << "</components></object>\n";
+    }
+    m_model << "</resources>\n<build>";
+    if (m_n_objects > 0) {
+      m_model << "<item objectid=\"";
+      put_index(m_n_objects + 1);
+      m_model << "\"/>";
+    }
+    m_model << "</build>\n</model>\n";
+    m_model.flush();
+    m_zip->end_entry();
+    m_zip->finish();
+  }
+} /* namespace mesh */
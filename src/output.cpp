@@ -0,0 +1,232 @@
+#include "output.hpp"
+
+#include <cstring>
+#include <cerrno>
+#include <limits>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace output {
+  static const double POW10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  static constexpr int MAX_EXACT_POW10 = 22;
+  // enough to round-trip any Float
+  static constexpr int MAX_PRECISION = std::numeric_limits<Float>::max_digits10;
+
+  inline double pow10(int e) {
+    if (e >= 0 && e <= MAX_EXACT_POW10) return POW10[e];
+    return std::pow(10.0, e);
+  }
+
+  // v * 10^e, exact whenever 10^e is
+  inline double scale10(double v, int e) {
+    if (e >= -MAX_EXACT_POW10 && e < 0) return v / POW10[-e];
+    return v * pow10(e);
+  }
+
+  // floor(log10(v)) for positive finite v
+  inline int decimal_exponent(double v) {
+    int binary_exponent;
+    std::frexp(v, &binary_exponent);
+    int e = static_cast<int>(std::floor((binary_exponent - 1) * 0.30102999566398120));
+    if (v >= pow10(e + 1)) ++e;
+    else if (v < pow10(e)) --e;
+    return e;
+  }
+
+  // round v to precision significant digits: v ~ mantissa * 10^(e - precision + 1)
+  inline uint64_t round_digits(double v, int precision, int* e) {
+    uint64_t mantissa = static_cast<uint64_t>(std::nearbyint(scale10(v, precision - 1 - *e)));
+    if (mantissa >= static_cast<uint64_t>(POW10[precision])) {
+      ++*e;
+      mantissa = static_cast<uint64_t>(std::nearbyint(scale10(v, precision - 1 - *e)));
+    }
+    return mantissa;
+  }
+
+  inline size_t write_digits(char* buf, uint64_t value, int n_digits) {
+    for (int i = n_digits - 1; i >= 0; --i) {
+      buf[i] = '0' + static_cast<char>(value % 10);
+      value /= 10;
+    }
+    return n_digits;
+  }
+
+  size_t format_float(char* buf, Float value, int precision) {
+    char* p = buf;
+    if (std::signbit(value)) *p++ = '-';
+    if (std::isnan(value)) {
+      std::memcpy(p, "nan", 3);
+      return p + 3 - buf;
+    }
+    if (std::isinf(value)) {
+      std::memcpy(p, "inf", 3);
+      return p + 3 - buf;
+    }
+    if (value == 0) {
+      *p++ = '0';
+      return p - buf;
+    }
+
+    const double v = std::abs(static_cast<double>(value));
+    int e = decimal_exponent(v);
+    uint64_t mantissa;
+    if (precision > 0) {
+      precision = std::min(precision, MAX_PRECISION);
+      mantissa = round_digits(v, precision, &e);
+    } else {
+      // shortest representation that reads back to the same Float
+      const int e0 = e;
+      for (precision = 1; precision <= MAX_PRECISION; ++precision) {
+        e = e0;
+        mantissa = round_digits(v, precision, &e);
+        if (static_cast<Float>(scale10(mantissa, e - precision + 1)) == std::abs(value)) break;
+      }
+      precision = std::min(precision, MAX_PRECISION);
+    }
+
+    // drop trailing zeros
+    int n_digits = precision;
+    while (n_digits > 1 && mantissa % 10 == 0) {
+      mantissa /= 10;
+      --n_digits;
+    }
+
+    char digits[MAX_PRECISION];
+    write_digits(digits, mantissa, n_digits);
+
+    if (e < -4 || e >= precision) {
+      // scientific notation: d.ddde+XX
+      *p++ = digits[0];
+      if (n_digits > 1) {
+        *p++ = '.';
+        std::memcpy(p, digits + 1, n_digits - 1);
+        p += n_digits - 1;
+      }
+      *p++ = 'e';
+      *p++ = e < 0 ? '-' : '+';
+      const int abs_e = std::abs(e);
+      p += write_digits(p, abs_e, abs_e >= 100 ? 3 : 2);
+    } else if (e < 0) {
+      // 0.000ddd
+      *p++ = '0';
+      *p++ = '.';
+      for (int i = -1; i > e; --i) *p++ = '0';
+      std::memcpy(p, digits, n_digits);
+      p += n_digits;
+    } else {
+      // ddd.ddd
+      const int n_int = e + 1;
+      for (int i = 0; i < n_int; ++i) *p++ = i < n_digits ? digits[i] : '0';
+      if (n_digits > n_int) {
+        *p++ = '.';
+        std::memcpy(p, digits + n_int, n_digits - n_int);
+        p += n_digits - n_int;
+      }
+    }
+    return p - buf;
+  }
+
+  writer::writer(const sink& output_sink, int precision, size_t capacity)
+    : m_sink(output_sink), m_buffer(std::max(capacity, FLOAT_BUFFER_SIZE)),
+    m_precision(precision) {}
+
+  sink fd_sink(int fd) {
+    return [fd](const char* data, size_t n) {
+      while (n > 0) {
+        const ssize_t written = ::write(fd, data, n);
+        if (written < 0) {
+          if (errno == EINTR) continue;
+          throw std::runtime_error(std::string("write failed: ") + std::strerror(errno));
+        }
+        data += written;
+        n -= written;
+      }
+    };
+  }
+
+  writer::writer(int fd, int precision, size_t capacity)
+    : m_fd(fd), m_sink(fd_sink(fd)), m_buffer(std::max(capacity, FLOAT_BUFFER_SIZE)),
+    m_precision(precision) {}
+
+  writer::writer(const std::string& fpath, int precision, size_t capacity)
+    : writer(-1, precision, capacity)
+  {
+    m_fd = ::open(fpath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (m_fd < 0) {
+      throw std::runtime_error("cannot open " + fpath + ": " + std::strerror(errno));
+    }
+    m_sink = fd_sink(m_fd);
+    m_owns_fd = true;
+  }
+
+  writer::~writer() {
+    try {
+      flush();
+    } catch (const std::exception&) {
+      // destructors must not throw; call flush() explicitly to see errors
+    }
+    if (m_owns_fd) ::close(m_fd);
+  }
+
+  void writer::flush() {
+    const size_t size = m_size;
+    m_size = 0;
+    if (size > 0) m_sink(m_buffer.data(), size);
+  }
+
+  void writer::redirect(const sink& output_sink) {
+    flush();
+    m_sink = output_sink;
+  }
+
+  void writer::discard() {
+    m_size = 0;
+  }
+
+  int writer::precision() const {
+    return m_precision;
+  }
+
+  int writer::fd() const {
+    return m_fd;
+  }
+
+  void writer::write(const char* data, size_t n) {
+    if (m_size + n > m_buffer.size()) {
+      flush();
+      if (n > m_buffer.size()) {
+        // too big to be worth buffering
+        m_sink(data, n);
+        return;
+      }
+    }
+    std::memcpy(m_buffer.data() + m_size, data, n);
+    m_size += n;
+  }
+
+  writer& writer::operator<<(char c) {
+    if (m_size == m_buffer.size()) flush();
+    m_buffer[m_size++] = c;
+    return *this;
+  }
+
+  writer& writer::operator<<(const char* str) {
+    write(str, std::strlen(str));
+    return *this;
+  }
+
+  writer& writer::operator<<(const std::string& str) {
+    write(str.data(), str.size());
+    return *this;
+  }
+
+  writer& writer::operator<<(Float value) {
+    if (m_size + FLOAT_BUFFER_SIZE > m_buffer.size()) flush();
+    m_size += format_float(m_buffer.data() + m_size, value, m_precision);
+    return *this;
+  }
+} /* namespace output */
@@ -0,0 +1,328 @@
+#include "path_data.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace path_data {
+  static const double POW10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  static constexpr int MAX_EXACT_POW10 = 22;
+  static constexpr uint64_t MAX_EXACT_MANTISSA = uint64_t(1) << 53;
+  // more digits than this cannot change a double
+  static constexpr uint64_t MANTISSA_LIMIT = 100000000000000000ull;
+
+  using svgpp::tag::coordinate::absolute;
+  using svgpp::tag::coordinate::relative;
+
+  // what Spirit's space skipper skips
+  inline bool is_space(char c) {
+    return c == ' ' || static_cast<unsigned char>(c - '\t') <= '\r' - '\t';
+  }
+
+  inline bool is_digit(char c) {
+    return static_cast<unsigned char>(c - '0') < 10;
+  }
+
+  inline const char* skip_spaces(const char* p, const char* end) {
+    // separators are mostly a single character, so check two before going wide
+    if (p == end || !is_space(*p)) return p;
+    if (++p == end || !is_space(*p)) return p;
+#ifdef __SSE2__
+    // long runs of indentation, 16 characters at a time
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i n_controls = _mm_set1_epi8('\r' - '\t');
+    const __m128i blank = _mm_set1_epi8(' ');
+    while (end - p >= 16) {
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      const __m128i control = _mm_sub_epi8(v, tab);
+      const __m128i spaces = _mm_or_si128(
+          _mm_cmpeq_epi8(_mm_min_epu8(control, n_controls), control),
+          _mm_cmpeq_epi8(v, blank));
+      const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(spaces));
+      if (mask != 0xffff) return p + __builtin_ctz(~mask);
+      p += 16;
+    }
+#endif
+    while (p < end && is_space(*p)) ++p;
+    return p;
+  }
+
+  bool parse_number(const char*& it, const char* end, double& value, bool signed_number) {
+    const char* p = it;
+    bool negative = false;
+    if (signed_number && p < end && (*p == '+' || *p == '-')) {
+      negative = *p == '-';
+      ++p;
+    }
+
+    // the leading digits that fit, scaled by 10^exponent
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    const char* const int_begin = p;
+    for (; p < end && is_digit(*p); ++p) {
+      if (mantissa < MANTISSA_LIMIT) mantissa = 10 * mantissa + (*p - '0');
+      else ++exponent;
+    }
+    const bool has_int = p != int_begin;
+    if (p < end && *p == '.') {
+      // like svgpp's policy, a dot must be followed by digits
+      if (++p == end || !is_digit(*p)) return false;
+      for (; p < end && is_digit(*p); ++p) {
+        if (mantissa < MANTISSA_LIMIT) {
+          mantissa = 10 * mantissa + (*p - '0');
+          --exponent;
+        }
+      }
+    } else if (!has_int) {
+      return false;
+    }
+
+    // an exponent without digits is not part of the number
+    if (p < end && (*p == 'e' || *p == 'E')) {
+      const char* q = p + 1;
+      bool negative_exponent = false;
+      if (q < end && (*q == '+' || *q == '-')) negative_exponent = *q++ == '-';
+      if (q < end && is_digit(*q)) {
+        int e = 0;
+        for (; q < end && is_digit(*q); ++q) {
+          if (e < 100000) e = 10 * e + (*q - '0');
+        }
+        exponent += negative_exponent ? -e : e;
+        p = q;
+      }
+    }
+
+    // svgpp gives up on exponents this far out, whatever the digits
+    if (exponent > std::numeric_limits<double>::max_exponent10
+        || exponent < 2 * std::numeric_limits<double>::min_exponent10) {
+      return false;
+    }
+
+    double v;
+    if (mantissa == 0) {
+      v = 0;
+    } else if (mantissa <= MAX_EXACT_MANTISSA && std::abs(exponent) <= MAX_EXACT_POW10) {
+      // both exact, so a single correctly rounded operation
+      v = exponent < 0 ? mantissa / POW10[-exponent] : mantissa * POW10[exponent];
+    } else {
+      // overflows to infinity within the exponent range, as with svgpp
+      v = static_cast<double>(
+          static_cast<long double>(mantissa) * std::pow(10.0L, static_cast<long double>(exponent)));
+    }
+    value = negative ? -v : v;
+    it = p;
+    return true;
+  }
+
+  /*
+   * Recursive descent over the grammar of svgpp's path_data_grammar. Every
+   * command is either parsed and sent as a whole or, if malformed, ends the
+   * parse where it starts, as Spirit backtracks there.
+   */
+  template <typename Coordinate>
+    class parser {
+      private:
+        const char* m_p;
+        const char* const m_end;
+        events<Coordinate>& m_events;
+
+        void skip_comma() {
+          m_p = skip_spaces(m_p, m_end);
+          if (m_p < m_end && *m_p == ',') ++m_p;
+        }
+
+        bool number(Coordinate& value, bool signed_number = true) {
+          m_p = skip_spaces(m_p, m_end);
+          double v;
+          if (!parse_number(m_p, m_end, v, signed_number)) return false;
+          value = static_cast<Coordinate>(v);
+          return true;
+        }
+
+        // n numbers, each but the first optionally preceded by a comma
+        bool numbers(Coordinate* values, int n) {
+          for (int i = 0; i < n; ++i) {
+            if (i > 0) skip_comma();
+            if (!number(values[i])) return false;
+          }
+          return true;
+        }
+
+        bool flag(bool& value) {
+          m_p = skip_spaces(m_p, m_end);
+          if (m_p == m_end || (*m_p != '0' && *m_p != '1')) return false;
+          value = *m_p++ == '1';
+          return true;
+        }
+
+        // one or more argument groups separated by optional commas
+        template <typename Group>
+          bool list(Group group) {
+            if (!group()) return false;
+            for (;;) {
+              const char* const save = m_p;
+              skip_comma();
+              if (!group()) {
+                m_p = save;
+                return true;
+              }
+            }
+          }
+
+        bool line_to_list(bool abs) {
+          return list([&] {
+            Coordinate c[2];
+            if (!numbers(c, 2)) return false;
+            if (abs) m_events.path_line_to(c[0], c[1], absolute());
+            else m_events.path_line_to(c[0], c[1], relative());
+            return true;
+          });
+        }
+
+        bool command(char c) {
+          const bool abs = c < 'a';
+          switch (c | 0x20) {
+            case 'm': {
+              Coordinate p[2];
+              if (!numbers(p, 2)) return false;
+              if (abs) m_events.path_move_to(p[0], p[1], absolute());
+              else m_events.path_move_to(p[0], p[1], relative());
+              // further pairs are implicit line_to
+              const char* const save = m_p;
+              skip_comma();
+              if (!line_to_list(abs)) m_p = save;
+              return true;
+            }
+            case 'z':
+              m_events.path_close_subpath();
+              return true;
+            case 'l':
+              return line_to_list(abs);
+            case 'h':
+            case 'v': {
+              const bool horizontal = (c | 0x20) == 'h';
+              return list([&] {
+                Coordinate v;
+                if (!number(v)) return false;
+                if (abs) m_events.path_line_to_ortho(v, horizontal, absolute());
+                else m_events.path_line_to_ortho(v, horizontal, relative());
+                return true;
+              });
+            }
+            case 'c':
+              return list([&] {
+                Coordinate v[6];
+                if (!numbers(v, 6)) return false;
+                if (abs) m_events.path_cubic_bezier_to(v[0], v[1], v[2], v[3], v[4], v[5], absolute());
+                else m_events.path_cubic_bezier_to(v[0], v[1], v[2], v[3], v[4], v[5], relative());
+                return true;
+              });
+            case 's':
+              return list([&] {
+                Coordinate v[4];
+                if (!numbers(v, 4)) return false;
+                if (abs) m_events.path_cubic_bezier_to(v[0], v[1], v[2], v[3], absolute());
+                else m_events.path_cubic_bezier_to(v[0], v[1], v[2], v[3], relative());
+                return true;
+              });
+            case 'q':
+              return list([&] {
+                Coordinate v[4];
+                if (!numbers(v, 4)) return false;
+                if (abs) m_events.path_quadratic_bezier_to(v[0], v[1], v[2], v[3], absolute());
+                else m_events.path_quadratic_bezier_to(v[0], v[1], v[2], v[3], relative());
+                return true;
+              });
+            case 't':
+              return list([&] {
+                Coordinate v[2];
+                if (!numbers(v, 2)) return false;
+                if (abs) m_events.path_quadratic_bezier_to(v[0], v[1], absolute());
+                else m_events.path_quadratic_bezier_to(v[0], v[1], relative());
+                return true;
+              });
+            case 'a':
+              return list([&] {
+                Coordinate rx, ry, rotation, p[2];
+                bool large_arc, sweep;
+                if (!number(rx, false)) return false;
+                skip_comma();
+                if (!number(ry, false)) return false;
+                skip_comma();
+                if (!number(rotation)) return false;
+                skip_comma();
+                if (!flag(large_arc)) return false;
+                skip_comma();
+                if (!flag(sweep)) return false;
+                skip_comma();
+                if (!numbers(p, 2)) return false;
+                if (abs) {
+                  m_events.path_elliptical_arc_to(
+                      rx, ry, rotation, large_arc, sweep, p[0], p[1], absolute());
+                } else {
+                  m_events.path_elliptical_arc_to(
+                      rx, ry, rotation, large_arc, sweep, p[0], p[1], relative());
+                }
+                return true;
+              });
+            default:
+              return false;
+          }
+        }
+
+      public:
+        parser(const char* begin, const char* end, events<Coordinate>& context)
+          : m_p(begin), m_end(end), m_events(context) {}
+
+        const char* run() {
+          bool started = false;
+          for (;;) {
+            const char* const save = m_p;
+            m_p = skip_spaces(m_p, m_end);
+            if (m_p == m_end) break;
+            const char c = *m_p++;
+            // every subpath group starts with a move_to
+            if ((!started && c != 'M' && c != 'm') || !command(c)) {
+              m_p = save;
+              break;
+            }
+            started = true;
+          }
+          m_events.path_exit();
+          return skip_spaces(m_p, m_end);
+        }
+    }; /* class parser */
+
+  template <typename Coordinate>
+    bool parse(const char*& it, const char* end, events<Coordinate>& context) {
+      it = parser<Coordinate>(it, end, context).run();
+      return true;
+    }
+
+  template bool parse<float>(const char*&, const char*, events<float>&);
+  template bool parse<double>(const char*&, const char*, events<double>&);
+} /* namespace path_data */
+
+#ifdef SVGPP_USE_EXTERNAL_PATH_DATA_PARSER
+// svgpp declares this hook and leaves its definition to one translation unit
+namespace svgpp {
+  namespace detail {
+    template <class Iterator, class Coordinate>
+      bool parse_path_data(Iterator& it, Iterator end, path_events_interface<Coordinate>& context) {
+        return path_data::parse(it, end, context);
+      }
+
+    template bool parse_path_data<const char*, float>(
+        const char*&, const char*, path_events_interface<float>&);
+    template bool parse_path_data<const char*, double>(
+        const char*&, const char*, path_events_interface<double>&);
+  } /* namespace detail */
+} /* namespace svgpp */
+#endif
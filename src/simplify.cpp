@@ -0,0 +1,71 @@
+#include <algorithm>
+
+#include "simplify.hpp"
+
+namespace simplify {
+  // squared distance from p to the segment [a, b]
+  inline double segment_distance_squared(
+      const vector2f& p,
+      const vector2f& a,
+      const vector2f& b)
+  {
+    const double dx = b.x - a.x, dy = b.y - a.y;
+    double px = p.x - a.x, py = p.y - a.y;
+    const double length_squared = dx * dx + dy * dy;
+    if (length_squared > 0) {
+      const double t = std::min(1.0, std::max(0.0, (px * dx + py * dy) / length_squared));
+      px -= t * dx;
+      py -= t * dy;
+    }
+    return px * px + py * py;
+  }
+
+  // set m_keep for the vertices of [first, last] that the simplified subpath needs
+  void simplifier::mark(
+      const std::vector<flatten::vertex>& vertices,
+      size_t first,
+      size_t last,
+      double tolerance_squared)
+  {
+    m_keep[first] = m_keep[last] = true;
+    m_stack.clear();
+    m_stack.emplace_back(first, last);
+    while (!m_stack.empty()) {
+      const size_t a = m_stack.back().first, b = m_stack.back().second;
+      m_stack.pop_back();
+
+      double max_distance = 0;
+      size_t farthest = a;
+      for (size_t i = a + 1; i < b; ++i) {
+        const double distance = segment_distance_squared(
+            vertices[i].position, vertices[a].position, vertices[b].position
+            );
+        if (distance > max_distance) {
+          max_distance = distance;
+          farthest = i;
+        }
+      }
+      if (max_distance <= tolerance_squared) continue;
+
+      m_keep[farthest] = true;
+      if (farthest - a > 1) m_stack.emplace_back(a, farthest);
+      if (b - farthest > 1) m_stack.emplace_back(farthest, b);
+    }
+  }
+
+  void simplifier::operator()(std::vector<flatten::vertex>& vertices, Float tolerance) {
+    const double tolerance_squared = static_cast<double>(tolerance) * tolerance;
+    m_keep.assign(vertices.size(), false);
+    for (size_t i = 0; i < vertices.size();) {
+      const size_t first = i;
+      for (++i; i < vertices.size() && !vertices[i].moveflag; ++i);
+      mark(vertices, first, i - 1, tolerance_squared);
+    }
+
+    size_t n_kept = 0;
+    for (size_t i = 0; i < vertices.size(); ++i) {
+      if (m_keep[i]) vertices[n_kept++] = vertices[i];
+    }
+    vertices.resize(n_kept);
+  }
+} /* namespace simplify */
@@ -0,0 +1,147 @@
+#include "stats.hpp"
+
+#include <cstdio>
+#include <sys/resource.h>
+
+namespace stats {
+  static const char* const STAGE_NAMES[N_STAGES] = {
+    "parse", "traverse", "flatten", "triangulate", "format", "write"
+  };
+
+  static const char* const COMMAND_NAMES[svg::action::ACTION_UNKNOWN] = {
+    "move_to", "line_to", "quadratic_bezier_to", "cubic_bezier_to", "elliptic_arc_to",
+    "close_subpath"
+  };
+
+  static thread_local scope* t_current_scope = nullptr;
+
+  counters::counters() : m_start(clock::now()), m_vertices(0), m_bytes_written(0) {
+    for (std::atomic<uint64_t>& n : m_nanoseconds) n = 0;
+    for (std::atomic<uint64_t>& n : m_commands) n = 0;
+  }
+
+  void counters::add_time(stage s, clock::duration elapsed) {
+    m_nanoseconds[s] += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+  }
+
+  void counters::add_elements(const std::map<std::string, uint64_t>& elements) {
+    std::lock_guard<std::mutex> lock(m_elements_mutex);
+    for (const auto& element : elements) m_elements[element.first] += element.second;
+  }
+
+  void counters::add_commands(const svg::path& path) {
+    uint64_t n[svg::action::ACTION_UNKNOWN] = {};
+    for (const uint8_t opcode : path.opcodes()) {
+      const uint8_t type = opcode & svg::action::OPCODE_TYPE_MASK;
+      if (type < svg::action::ACTION_UNKNOWN) ++n[type];
+    }
+    for (size_t i = 0; i < svg::action::ACTION_UNKNOWN; ++i) m_commands[i] += n[i];
+  }
+
+  void counters::add_vertices(size_t n) {
+    m_vertices += n;
+  }
+
+  void counters::add_bytes_written(size_t n) {
+    m_bytes_written += n;
+  }
+
+  void counters::print(output::writer& out) {
+    char line[128];
+    auto print_count = [&](const char* name, uint64_t n) {
+      out.write(line, std::snprintf(line, sizeof(line), "  %-20s %12llu\n",
+            name, static_cast<unsigned long long>(n)));
+    };
+
+    const double wall = std::chrono::duration<double>(clock::now() - m_start).count();
+    out.write(line, std::snprintf(line, sizeof(line), "wall time %.6f s\nstages\n", wall));
+    for (size_t s = 0; s < N_STAGES; ++s) {
+      out.write(line, std::snprintf(line, sizeof(line), "  %-20s %12.6f s\n",
+            STAGE_NAMES[s], m_nanoseconds[s] * 1e-9));
+    }
+    out << "elements\n";
+    {
+      std::lock_guard<std::mutex> lock(m_elements_mutex);
+      for (const auto& element : m_elements) print_count(element.first.c_str(), element.second);
+    }
+    out << "commands\n";
+    for (size_t i = 0; i < svg::action::ACTION_UNKNOWN; ++i) {
+      print_count(COMMAND_NAMES[i], m_commands[i]);
+    }
+    print_count("vertices", m_vertices);
+    print_count("bytes written", m_bytes_written);
+    print_count("peak RSS bytes", peak_rss());
+  }
+
+  void counters::print_json(output::writer& out) {
+    char field[128];
+    auto print_count = [&](const char* name, uint64_t n) {
+      out.write(field, std::snprintf(field, sizeof(field), "\"%s\":%llu",
+            name, static_cast<unsigned long long>(n)));
+    };
+
+    const double wall = std::chrono::duration<double>(clock::now() - m_start).count();
+    out.write(field, std::snprintf(field, sizeof(field), "{\"wall_seconds\":%.9g", wall));
+    out << ",\"stage_seconds\":{";
+    for (size_t s = 0; s < N_STAGES; ++s) {
+      if (s > 0) out << ',';
+      out.write(field, std::snprintf(field, sizeof(field), "\"%s\":%.9g",
+            STAGE_NAMES[s], m_nanoseconds[s] * 1e-9));
+    }
+    // XML names hold no characters that need escaping in JSON
+    out << "},\"elements\":{";
+    {
+      std::lock_guard<std::mutex> lock(m_elements_mutex);
+      for (auto it = m_elements.begin(); it != m_elements.end(); ++it) {
+        if (it != m_elements.begin()) out << ',';
+        out << '"' << it->first << "\":";
+        out.write(field, std::snprintf(field, sizeof(field), "%llu",
+              static_cast<unsigned long long>(it->second)));
+      }
+    }
+    out << "},\"commands\":{";
+    for (size_t i = 0; i < svg::action::ACTION_UNKNOWN; ++i) {
+      if (i > 0) out << ',';
+      print_count(COMMAND_NAMES[i], m_commands[i]);
+    }
+    out << "},";
+    print_count("vertices", m_vertices);
+    out << ',';
+    print_count("bytes_written", m_bytes_written);
+    out << ',';
+    print_count("peak_rss_bytes", peak_rss());
+    out << "}\n";
+  }
+
+  scope::scope(counters* c, stage s) : m_counters(c), m_stage(s) {
+    if (!m_counters) return;
+    m_start = clock::now();
+    m_outer = t_current_scope;
+    // scopes without counters never become current
+    if (m_outer) m_outer->m_counters->add_time(m_outer->m_stage, m_start - m_outer->m_start);
+    t_current_scope = this;
+  }
+
+  scope::~scope() {
+    if (!m_counters) return;
+    const clock::time_point now = clock::now();
+    m_counters->add_time(m_stage, now - m_start);
+    t_current_scope = m_outer;
+    if (m_outer) m_outer->m_start = now;
+  }
+
+  output::sink counted_sink(const output::sink& s, counters& c) {
+    return [s, &c](const char* data, size_t n) {
+      scope write_scope(&c, STAGE_WRITE);
+      s(data, n);
+      c.add_bytes_written(n);
+    };
+  }
+
+  uint64_t peak_rss() {
+    struct rusage usage;
+    if (::getrusage(RUSAGE_SELF, &usage) < 0) return 0;
+    // kilobytes on Linux
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+  }
+} /* namespace stats */
@@ -0,0 +1,231 @@
+#include <algorithm>
+
+#include "stroke.hpp"
+#include "math/util.hpp"
+
+namespace stroke {
+  static constexpr size_t MAX_ARC_STEPS = 256;
+
+  options::options(const svg::style& paint, const flatten::options& flatten_options)
+    : width(paint.stroke_width), line_join(paint.line_join), line_cap(paint.line_cap),
+    miter_limit(paint.miter_limit), flatten(flatten_options) {}
+
+  // number of chords approximating an arc of the given angle and radius
+  inline size_t arc_steps(Float angle, Float radius, const flatten::options& opts) {
+    Float estimate;
+    if (opts.tolerance <= 0) {
+      estimate = opts.n_segments * angle / PI;
+    } else if (opts.tolerance >= radius) {
+      estimate = 1;
+    } else {
+      estimate = angle / (2.0f * std::acos(1.0f - opts.tolerance / radius));
+    }
+    if (!(estimate >= 1)) return 1;
+    return std::min(MAX_ARC_STEPS, static_cast<size_t>(std::ceil(estimate)));
+  }
+
+  inline vector2f rotate(const vector2f& v, Float angle) {
+    const Float c = std::cos(angle), s = std::sin(angle);
+    return vector2f(c * v.x - s * v.y, s * v.x + c * v.y);
+  }
+
+  inline vector2f left_normal(const vector2f& direction) {
+    return vector2f(-direction.y, direction.x);
+  }
+
+  inline Float cross(const vector2f& a, const vector2f& b) {
+    return a.x * b.y - a.y * b.x;
+  }
+
+  class outliner {
+    private:
+      const options& m_options;
+      const Float m_half_width;
+      std::vector<vector2f>& m_points;
+      std::vector<size_t>& m_piece_ends;
+
+      // points strictly between from and to on the arc of radius m_half_width around center
+      void push_arc(const vector2f& center, const vector2f& from, Float angle) {
+        const size_t n_steps = arc_steps(std::abs(angle), m_half_width, m_options.flatten);
+        for (size_t i = 1; i < n_steps; ++i) {
+          m_points.push_back(center + m_half_width * rotate(from, angle * i / n_steps));
+        }
+      }
+
+      void end_piece() {
+        m_piece_ends.push_back(m_points.size());
+      }
+
+      void push_start_cap(const vector2f& a, const vector2f& d, const vector2f& n) {
+        const vector2f h = m_half_width * n;
+        switch (m_options.line_cap) {
+          case svg::style::LINE_CAP_SQUARE: {
+            const vector2f back = a - m_half_width * d;
+            m_points.push_back(back + h);
+            m_points.push_back(back - h);
+            break;
+          }
+          case svg::style::LINE_CAP_ROUND:
+            m_points.push_back(a + h);
+            push_arc(a, n, PI);
+            m_points.push_back(a - h);
+            break;
+          default:
+            m_points.push_back(a + h);
+            m_points.push_back(a - h);
+        }
+      }
+
+      void push_end_cap(const vector2f& b, const vector2f& d, const vector2f& n) {
+        const vector2f h = m_half_width * n;
+        switch (m_options.line_cap) {
+          case svg::style::LINE_CAP_SQUARE: {
+            const vector2f front = b + m_half_width * d;
+            m_points.push_back(front - h);
+            m_points.push_back(front + h);
+            break;
+          }
+          case svg::style::LINE_CAP_ROUND:
+            m_points.push_back(b - h);
+            push_arc(b, -n, PI);
+            m_points.push_back(b + h);
+            break;
+          default:
+            m_points.push_back(b - h);
+            m_points.push_back(b + h);
+        }
+      }
+
+      /*
+       * End of a segment heading d into vertex b where the next one heads d2.
+       * The outer side gets the join, the inner side goes through b itself so
+       * the piece stays simple however sharp the turn.
+       */
+      void push_join(const vector2f& b, const vector2f& d, const vector2f& d2) {
+        const vector2f n = left_normal(d), n2 = left_normal(d2);
+        const Float turn_cross = cross(d, d2);
+        const Float turn_dot = d.dot(d2);
+        if (turn_dot > 0 && std::abs(turn_cross) <= FLOAT_TOLERANT) {
+          m_points.push_back(b - m_half_width * n);
+          m_points.push_back(b + m_half_width * n);
+          return;
+        }
+
+        // outer normals before and after the vertex, turning by angle from o1 to o2
+        const bool left_turn = turn_cross >= 0;
+        const vector2f o1 = left_turn ? -n : n;
+        const vector2f o2 = left_turn ? -n2 : n2;
+        const Float angle = (left_turn ? 1 : -1) * std::atan2(std::abs(turn_cross), turn_dot);
+
+        const size_t outer_begin = m_points.size() + (left_turn ? 1 : 3);
+        m_points.push_back(b - m_half_width * n);
+        if (!left_turn) {
+          m_points.push_back(b);
+          m_points.push_back(b + m_half_width * n2);
+        }
+        switch (m_options.line_join) {
+          case svg::style::LINE_JOIN_MITER: {
+            const Float ratio = std::sqrt(2.0f / std::max(1.0f + turn_dot, FLOAT_TOLERANT));
+            if (ratio <= m_options.miter_limit) {
+              m_points.push_back(b + m_half_width / (1.0f + turn_dot) * (o1 + o2));
+            }
+            break;
+          }
+          case svg::style::LINE_JOIN_ROUND:
+            push_arc(b, o1, angle);
+            break;
+          default:
+            break;
+        }
+        // arcs run from o1 to o2, but a right turn meets o2 first
+        if (!left_turn) std::reverse(m_points.begin() + outer_begin, m_points.end());
+        if (left_turn) {
+          m_points.push_back(b - m_half_width * n2);
+          m_points.push_back(b);
+        }
+        m_points.push_back(b + m_half_width * n);
+      }
+
+      // a subpath of zero length only shows its caps
+      void push_dot(const vector2f& p) {
+        const vector2f d(1, 0), n(0, 1);
+        switch (m_options.line_cap) {
+          case svg::style::LINE_CAP_SQUARE:
+          case svg::style::LINE_CAP_ROUND:
+            push_start_cap(p, d, n);
+            push_end_cap(p, d, n);
+            end_piece();
+            break;
+          default:
+            break;
+        }
+      }
+
+    public:
+      outliner(
+          const options& opts,
+          std::vector<vector2f>& points,
+          std::vector<size_t>& piece_ends)
+        : m_options(opts), m_half_width(0.5f * opts.width), m_points(points),
+        m_piece_ends(piece_ends) {}
+
+      void subpath(const std::vector<vector2f>& p, bool closed) {
+        if (p.size() == 1) {
+          push_dot(p[0]);
+          return;
+        }
+
+        const size_t n_segments = closed ? p.size() : p.size() - 1;
+        vector2f d = (p[1] - p[0]).normalized();
+        for (size_t i = 0; i < n_segments; ++i) {
+          const vector2f& a = p[i];
+          const vector2f& b = p[(i + 1) % p.size()];
+          const vector2f n = left_normal(d);
+          if (!closed && i == 0) {
+            push_start_cap(a, d, n);
+          } else {
+            m_points.push_back(a + m_half_width * n);
+            m_points.push_back(a - m_half_width * n);
+          }
+          if (!closed && i + 1 == n_segments) {
+            push_end_cap(b, d, n);
+            end_piece();
+            break;
+          }
+          const vector2f d2 = (p[(i + 2) % p.size()] - b).normalized();
+          push_join(b, d, d2);
+          end_piece();
+          d = d2;
+        }
+      }
+  }; /* class outliner */
+
+  void outline(
+      const std::vector<flatten::vertex>& vertices,
+      const options& opts,
+      std::vector<vector2f>& points,
+      std::vector<size_t>& piece_ends)
+  {
+    if (!(opts.width > 0)) return;
+    outliner stroker(opts, points, piece_ends);
+    std::vector<vector2f> subpath;
+    for (size_t i = 0; i < vertices.size();) {
+      // drop repeated points, which have no direction
+      subpath.clear();
+      const size_t first = i;
+      for (; i < vertices.size() && (i == first || !vertices[i].moveflag); ++i) {
+        const vector2f& v = vertices[i].position;
+        if (subpath.empty() || !COMPARE_EQ((v - subpath.back()).size(), 0)) {
+          subpath.push_back(v);
+        }
+      }
+      const bool closed = vertices[i - 1].closeflag;
+      if (closed && subpath.size() > 1
+          && COMPARE_EQ((subpath.back() - subpath.front()).size(), 0))
+      {
+        subpath.pop_back();
+      }
+      stroker.subpath(subpath, closed && subpath.size() > 1);
+    }
+  }
+} /* namespace stroke */
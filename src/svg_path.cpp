@@ -0,0 +1,123 @@
+#include "svg_path.hpp"
+
+namespace svg {
+  bool style::operator==(const style& rhs) const {
+    return filled == rhs.filled && fill_rule == rhs.fill_rule && stroked == rhs.stroked
+      && line_join == rhs.line_join && line_cap == rhs.line_cap
+      && stroke_width == rhs.stroke_width && miter_limit == rhs.miter_limit;
+  }
+
+  void path::begin_shape(const style& paint) {
+    m_shapes.push_back({ m_opcodes.size(), m_coords.size(), paint });
+  }
+
+  void path::move_to(const vector2f& dst) {
+    m_opcodes.push_back(action::ACTION_MOVE_TO);
+    m_coords.insert(m_coords.end(), { dst.x, dst.y });
+  }
+
+  void path::line_to(const vector2f& dst) {
+    m_opcodes.push_back(action::ACTION_LINE_TO);
+    m_coords.insert(m_coords.end(), { dst.x, dst.y });
+  }
+
+  void path::quadratic_bezier_to(const vector2f& p1, const vector2f& p2) {
+    m_opcodes.push_back(action::ACTION_QUAD_BEZIER_TO);
+    m_coords.insert(m_coords.end(), { p1.x, p1.y, p2.x, p2.y });
+  }
+
+  void path::cubic_bezier_to(const vector2f& p1, const vector2f& p2, const vector2f& p3) {
+    m_opcodes.push_back(action::ACTION_CUBIC_BEZIER_TO);
+    m_coords.insert(m_coords.end(), { p1.x, p1.y, p2.x, p2.y, p3.x, p3.y });
+  }
+
+  void path::elliptic_arc_to(
+      const vector2f& r,
+      Float x_axis_rotation,
+      const vector2f& dst,
+      bool large_arc,
+      bool sweep)
+  {
+    uint8_t opcode = action::ACTION_ELLIPTIC_ARC_TO;
+    if (large_arc) opcode |= action::OPCODE_LARGE_ARC;
+    if (sweep) opcode |= action::OPCODE_SWEEP;
+    m_opcodes.push_back(opcode);
+    m_coords.insert(m_coords.end(), { r.x, r.y, x_axis_rotation, dst.x, dst.y });
+  }
+
+  void path::close_subpath() {
+    m_opcodes.push_back(action::ACTION_CLOSE_SUBPATH);
+  }
+
+  void path::add_instance(size_t definition, const std::array<Float, 6>& transform) {
+    m_instances.push_back({ definition, transform });
+  }
+
+  void path::reserve(size_t n_commands, size_t n_coords) {
+    m_opcodes.reserve(n_commands);
+    m_coords.reserve(n_coords);
+  }
+
+  void path::clear() {
+    m_opcodes.clear();
+    m_coords.clear();
+    m_shapes.clear();
+    m_instances.clear();
+  }
+
+  size_t path::size() const {
+    return m_opcodes.size();
+  }
+
+  bool path::empty() const {
+    return m_opcodes.empty();
+  }
+
+  const std::vector<uint8_t>& path::opcodes() const {
+    return m_opcodes;
+  }
+
+  const std::vector<Float>& path::coords() const {
+    return m_coords;
+  }
+
+  const std::vector<path::shape>& path::shapes() const {
+    return m_shapes;
+  }
+
+  const std::vector<path::instance>& path::instances() const {
+    return m_instances;
+  }
+
+  path::range path::shape_commands(size_t i) const {
+    const size_t last = i + 1 < m_shapes.size() ? m_shapes[i + 1].first : m_opcodes.size();
+    return { m_shapes[i].first, last, m_shapes[i].coord_offset };
+  }
+
+  std::vector<path::range> path::split(size_t n_parts, bool whole_shapes) const {
+    std::vector<range> ranges;
+    const size_t part_size = m_opcodes.size() / std::max<size_t>(1, n_parts) + 1;
+    range current { 0, 0, 0 };
+    size_t coord_offset = 0;
+    size_t next_shape = 0;
+    for (size_t i = 0; i < m_opcodes.size(); ++i) {
+      const uint8_t opcode = m_opcodes[i];
+      bool shape_start = false;
+      while (next_shape < m_shapes.size() && m_shapes[next_shape].first <= i) {
+        shape_start = m_shapes[next_shape++].first == i;
+      }
+      if ((opcode & action::OPCODE_TYPE_MASK) == action::ACTION_MOVE_TO
+          && (!whole_shapes || shape_start)
+          && i - current.first >= part_size)
+      {
+        current.last = i;
+        ranges.push_back(current);
+        current = { i, i, coord_offset };
+      }
+      coord_offset += action::n_coords(opcode);
+    }
+    current.last = m_opcodes.size();
+    if (current.last > current.first) ranges.push_back(current);
+    return ranges;
+  }
+} /* namespace svg */
@@ -1,129 +1,657 @@
 #include <iostream>
+#include <map>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
 
 #include "svg_reader.hpp"
+#include "mapped_file.hpp"
+#include "path_data.hpp"
 
 namespace svg {
+  /*
+   * Minimal XML scanner used by reader::stream_file to find element boundaries
+   * without building a DOM. It only understands what is needed to skip over
+   * markup: comments, CDATA, processing instructions, declarations and quoted
+   * attribute values.
+   */
+  namespace scan {
+    inline std::runtime_error truncated() {
+      return std::runtime_error("unexpected end of SVG file");
+    }
+
+    inline bool starts_with(const char* p, const char* end, const char* prefix) {
+      const size_t n = std::strlen(prefix);
+      return static_cast<size_t>(end - p) >= n && std::memcmp(p, prefix, n) == 0;
+    }
+
+    inline const char* find(const char* p, const char* end, const char* token) {
+      const size_t n = std::strlen(token);
+      for (; static_cast<size_t>(end - p) >= n; ++p) {
+        p = static_cast<const char*>(std::memchr(p, token[0], end - p));
+        if (!p || static_cast<size_t>(end - p) < n) break;
+        if (std::memcmp(p, token, n) == 0) return p;
+      }
+      throw truncated();
+    }
+
+    // p points at '<' of a start tag; returns one past its '>'
+    inline const char* skip_start_tag(const char* p, const char* end, bool* self_closing) {
+      char quote = 0;
+      for (++p; p < end; ++p) {
+        if (quote) {
+          if (*p == quote) quote = 0;
+        } else if (*p == '"' || *p == '\'') {
+          quote = *p;
+        } else if (*p == '>') {
+          *self_closing = p[-1] == '/';
+          return p + 1;
+        }
+      }
+      throw truncated();
+    }
+
+    // p points at '<' of something that is not an element; returns one past it
+    inline const char* skip_markup(const char* p, const char* end) {
+      if (starts_with(p, end, "<!--")) return find(p + 4, end, "-->") + 3;
+      if (starts_with(p, end, "<![CDATA[")) return find(p + 9, end, "]]>") + 3;
+      if (starts_with(p, end, "<?")) return find(p + 2, end, "?>") + 2;
+      // <!DOCTYPE ...> possibly with an internal subset in brackets
+      const char* close = find(p, end, ">");
+      const char* subset = static_cast<const char*>(std::memchr(p, '[', close - p));
+      if (subset) close = find(find(subset, end, "]"), end, ">");
+      return close + 1;
+    }
+
+    inline bool is_element_start(const char* p, const char* end) {
+      return p + 1 < end && p[1] != '/' && p[1] != '!' && p[1] != '?';
+    }
+
+    // p points at '<' of a start tag; whether it opens <defs> or <symbol>, with any prefix
+    inline bool is_definition(const char* p, const char* end) {
+      const char* name = ++p;
+      for (; p < end && !std::strchr(" \t\r\n/>", *p); ++p) {
+        if (*p == ':') name = p + 1;
+      }
+      const size_t n = p - name;
+      return (n == 4 && std::memcmp(name, "defs", 4) == 0)
+        || (n == 6 && std::memcmp(name, "symbol", 6) == 0);
+    }
+
+    // p points at '<' of a start tag; returns one past the matching end tag
+    inline const char* skip_element(const char* p, const char* end) {
+      size_t depth = 0;
+      while (true) {
+        if (p[1] == '/') {
+          p = find(p, end, ">") + 1;
+          if (--depth == 0) return p;
+        } else if (is_element_start(p, end)) {
+          bool self_closing = false;
+          p = skip_start_tag(p, end, &self_closing);
+          if (!self_closing) ++depth;
+          if (depth == 0) return p;
+        } else {
+          p = skip_markup(p, end);
+        }
+        p = static_cast<const char*>(std::memchr(p, '<', end - p));
+        if (!p) throw truncated();
+      }
+    }
+  } /* namespace scan */
+
+  // must come first: attribute_traversal declares no other keyword and would
+  // take a preceding one as a positional argument
+  typedef svgpp::document_traversal<
+    svgpp::attribute_traversal_policy<attribute_traversal_policy>,
+    svgpp::processed_elements<processed_element_t>,
+    svgpp::processed_attributes<processed_attribute_t>
+      > document_traversal_t;
+
+  reader::context::context(reader& owner)
+    : m_reader(owner), m_target(&m_path), m_states(1, { matrix3f(1), style() }) {
+  }
+
   reader::context::~context() {
   }
 
-  const std::vector<std::shared_ptr<action::base>>& reader::context::actions() const {
-    return m_actions;
+  const path& reader::context::actions() const {
+    return m_path;
+  }
+
+  void reader::context::clear() {
+    m_path.clear();
+    m_target = &m_path;
+    m_states.assign(1, { matrix3f(1), style() });
+    m_in_shape = false;
+    m_saved.clear();
+  }
+
+  void reader::context::begin_definition(path& definition, const style& paint) {
+    m_saved.push_back({ m_target, std::move(m_states), m_in_shape });
+    m_target = &definition;
+    m_states.assign(1, { matrix3f(1), paint });
+    m_in_shape = false;
+  }
+
+  void reader::context::end_definition() {
+    saved_state& saved = m_saved.back();
+    m_target = saved.target;
+    m_states = std::move(saved.states);
+    m_in_shape = saved.in_shape;
+    m_saved.pop_back();
   }
 
-  void reader::context::path_move_to(float x, float y, svgpp::tag::coordinate::absolute) {
-    m_actions.push_back(std::make_shared<action::move_to>(action::move_to(vector2f(x, y))));
+  vector2f reader::context::transform_point(Float x, Float y) const {
+    const matrix3f& m = m_states.back().transform;
+    return {
+      m[0][0] * x + m[0][1] * y + m[0][2],
+      m[1][0] * x + m[1][1] * y + m[1][2]
+    };
   }
 
-  void reader::context::path_line_to(float x, float y, svgpp::tag::coordinate::absolute) {
-    m_actions.push_back(std::make_shared<action::line_to>(action::line_to(vector2f(x, y))));
+  void reader::context::begin_command() {
+    if (m_in_shape) return;
+    // coordinates are stored transformed, so scale the stroke along with them
+    const matrix3f& m = m_states.back().transform;
+    style paint = m_states.back().paint;
+    paint.stroke_width *= std::sqrt(std::abs(m[0][0] * m[1][1] - m[0][1] * m[1][0]));
+    m_target->begin_shape(paint);
+    m_in_shape = true;
+  }
+
+  void reader::context::path_move_to(Float x, Float y, svgpp::tag::coordinate::absolute) {
+    begin_command();
+    m_target->move_to(transform_point(x, y));
+  }
+
+  void reader::context::path_line_to(Float x, Float y, svgpp::tag::coordinate::absolute) {
+    begin_command();
+    m_target->line_to(transform_point(x, y));
   }
 
   void reader::context::path_quadratic_bezier_to(
-      float x1, float y1,
-      float x, float y,
+      Float x1, Float y1,
+      Float x, Float y,
       svgpp::tag::coordinate::absolute)
   {
-    m_actions.push_back(
-        std::make_shared<action::quadratic_bezier_to>(
-          action::quadratic_bezier_to({ x1, y1 }, { x, y })
-          )
-        );
+    begin_command();
+    m_target->quadratic_bezier_to(transform_point(x1, y1), transform_point(x, y));
   }
 
   void reader::context::path_cubic_bezier_to(
-      float x1, float y1,
-      float x2, float y2,
-      float x, float y,
+      Float x1, Float y1,
+      Float x2, Float y2,
+      Float x, Float y,
       svgpp::tag::coordinate::absolute)
   {
-    m_actions.push_back(
-        std::make_shared<action::cubic_bezier_to>(
-          action::cubic_bezier_to(
-            { x1, y1 },
-            { x2, y2 },
-            { x, y }
-            )
-          )
-        );
+    begin_command();
+    m_target->cubic_bezier_to(transform_point(x1, y1), transform_point(x2, y2), transform_point(x, y));
   }
 
   void reader::context::path_elliptical_arc_to(
-      float rx, float ry, float x_axis_rotation,
+      Float rx, Float ry, Float x_axis_rotation,
       bool large_arc_flag, bool sweep_flag,
-      float x, float y,
+      Float x, Float y,
       svgpp::tag::coordinate::absolute)
   {
-    m_actions.push_back(
-        std::make_shared<action::elliptic_arc_to>(
-          action::elliptic_arc_to(
-            { rx, ry },
-            x_axis_rotation,
-            { x, y },
-            large_arc_flag,
-            sweep_flag
-            )
-          )
-        );
+    begin_command();
+    const matrix3f& m = m_states.back().transform;
+    vector2f r(std::abs(rx), std::abs(ry));
+    if (!COMPARE_EQ(r.x, 0) && !COMPARE_EQ(r.y, 0)) {
+      // the image of the ellipse is the ellipse of E * E^T, where E maps the
+      // unit circle onto the transformed ellipse; its eigenvectors are the new axes
+      const Float angle = radians(x_axis_rotation);
+      const Float c = std::cos(angle), s = std::sin(angle);
+      const vector2f u(
+          (m[0][0] * c + m[0][1] * s) * r.x,
+          (m[1][0] * c + m[1][1] * s) * r.x);
+      const vector2f v(
+          (m[0][1] * c - m[0][0] * s) * r.y,
+          (m[1][1] * c - m[1][0] * s) * r.y);
+      const Float a = u.x * u.x + v.x * v.x;
+      const Float b = u.x * u.y + v.x * v.y;
+      const Float d = u.y * u.y + v.y * v.y;
+      const Float mean = 0.5f * (a + d);
+      const Float root = std::hypot(0.5f * (a - d), b);
+      r = vector2f(std::sqrt(mean + root), std::sqrt(std::max<Float>(0, mean - root)));
+      x_axis_rotation = degrees(0.5f * std::atan2(2.0f * b, a - d));
+      // a mirroring transform reverses the direction of travel
+      if (m[0][0] * m[1][1] - m[0][1] * m[1][0] < 0) sweep_flag = !sweep_flag;
+    }
+    m_target->elliptic_arc_to(r, x_axis_rotation, transform_point(x, y), large_arc_flag, sweep_flag);
   }
 
   void reader::context::path_close_subpath() {
+    begin_command();
+    m_target->close_subpath();
   }
 
   void reader::context::path_exit() {
+    m_in_shape = false;
+  }
+
+  void reader::context::transform_matrix(const boost::array<Float, 6>& matrix) {
+    // SVG's [a b c d e f] is the affine matrix [a c e; b d f; 0 0 1]
+    const matrix3f local(
+        { matrix[0], matrix[1], 0 },
+        { matrix[2], matrix[3], 0 },
+        { matrix[4], matrix[5], 1 });
+    m_states.back().transform = m_states.back().transform * local;
+  }
+
+  void reader::context::set(svgpp::tag::attribute::fill, svgpp::tag::value::none) {
+    m_states.back().paint.filled = false;
+  }
+
+  void reader::context::set(svgpp::tag::attribute::fill, svgpp::tag::value::inherit) {
+  }
+
+  void reader::context::set(svgpp::tag::attribute::fill_rule, svgpp::tag::value::nonzero) {
+    m_states.back().paint.fill_rule = style::FILL_RULE_NONZERO;
+  }
+
+  void reader::context::set(svgpp::tag::attribute::fill_rule, svgpp::tag::value::evenodd) {
+    m_states.back().paint.fill_rule = style::FILL_RULE_EVENODD;
+  }
+
+  void reader::context::set(svgpp::tag::attribute::fill_rule, svgpp::tag::value::inherit) {
+  }
+
+  void reader::context::set(svgpp::tag::attribute::stroke, svgpp::tag::value::none) {
+    m_states.back().paint.stroked = false;
+  }
+
+  void reader::context::set(svgpp::tag::attribute::stroke, svgpp::tag::value::inherit) {
+  }
+
+  void reader::context::set(svgpp::tag::attribute::stroke_width, Float width) {
+    m_states.back().paint.stroke_width = width;
+  }
+
+  void reader::context::set(svgpp::tag::attribute::stroke_width, svgpp::tag::value::inherit) {
+  }
+
+  void reader::context::set(svgpp::tag::attribute::stroke_linejoin, svgpp::tag::value::miter) {
+    m_states.back().paint.line_join = style::LINE_JOIN_MITER;
+  }
+
+  void reader::context::set(svgpp::tag::attribute::stroke_linejoin, svgpp::tag::value::round) {
+    m_states.back().paint.line_join = style::LINE_JOIN_ROUND;
+  }
+
+  void reader::context::set(svgpp::tag::attribute::stroke_linejoin, svgpp::tag::value::bevel) {
+    m_states.back().paint.line_join = style::LINE_JOIN_BEVEL;
+  }
+
+  void reader::context::set(svgpp::tag::attribute::stroke_linejoin, svgpp::tag::value::inherit) {
+  }
+
+  void reader::context::set(svgpp::tag::attribute::stroke_linecap, svgpp::tag::value::butt) {
+    m_states.back().paint.line_cap = style::LINE_CAP_BUTT;
+  }
+
+  void reader::context::set(svgpp::tag::attribute::stroke_linecap, svgpp::tag::value::round) {
+    m_states.back().paint.line_cap = style::LINE_CAP_ROUND;
+  }
+
+  void reader::context::set(svgpp::tag::attribute::stroke_linecap, svgpp::tag::value::square) {
+    m_states.back().paint.line_cap = style::LINE_CAP_SQUARE;
+  }
+
+  void reader::context::set(svgpp::tag::attribute::stroke_linecap, svgpp::tag::value::inherit) {
+  }
+
+  void reader::context::set(svgpp::tag::attribute::stroke_miterlimit, Float limit) {
+    m_states.back().paint.miter_limit = limit;
+  }
+
+  void reader::context::set(svgpp::tag::attribute::stroke_miterlimit, svgpp::tag::value::inherit) {
+  }
+
+  void reader::context::set(svgpp::tag::attribute::x, Float x) {
+    m_use_offset.x = x;
+  }
+
+  void reader::context::set(svgpp::tag::attribute::y, Float y) {
+    m_use_offset.y = y;
   }
 
   void reader::context::on_enter_element(svgpp::tag::element::any) {
+    // children start from their parent's transform and style
+    m_states.push_back(m_states.back());
+    m_states.back().is_use = false;
+  }
 
+  void reader::context::on_enter_element(svgpp::tag::element::use_) {
+    m_states.push_back(m_states.back());
+    m_states.back().is_use = true;
+    m_href.clear();
+    m_use_offset = vector2f(0);
   }
 
   void reader::context::on_exit_element() {
+    if (m_states.back().is_use && !m_href.empty()) {
+      // <use> adds translate(x, y) after its own transform
+      const matrix3f& m = m_states.back().transform;
+      const vector2f& o = m_use_offset;
+      const std::array<Float, 6> transform = {{
+        m[0][0], m[1][0], m[0][1], m[1][1],
+        m[0][0] * o.x + m[0][1] * o.y + m[0][2],
+        m[1][0] * o.x + m[1][1] * o.y + m[1][2]
+      }};
+      const std::string href = std::move(m_href);
+      const size_t definition = m_reader.load_definition(href, m_states.back().paint);
+      if (definition != NO_DEFINITION) m_target->add_instance(definition, transform);
+    }
+    m_states.pop_back();
+  }
 
+  bool skips_contents(const rapidxml_ns::xml_node<>* element) {
+    static const char* const SKIPPED[] = {
+      "desc", "foreignObject", "image", "metadata", "script", "style", "text", "title"
+    };
+    const size_t ns_size = element->namespace_uri_size();
+    if (ns_size != sizeof(SVGPP_SVG_NAMESPACE_URI) - 1
+        || std::memcmp(element->namespace_uri(), SVGPP_SVG_NAMESPACE_URI, ns_size) != 0)
+    {
+      // svgpp never enters elements of other namespaces; elements of none are
+      // kept, the root of a document without xmlns being one
+      return ns_size > 0;
+    }
+    for (const char* name : SKIPPED) {
+      if (element->local_name_size() == std::strlen(name)
+          && std::memcmp(element->local_name(), name, element->local_name_size()) == 0)
+      {
+        return true;
+      }
+    }
+    return false;
   }
 
-  reader::reader() {
+  reader::reader() : m_context(*this) {
+    m_document.set_skip_contents(skips_contents);
   }
 
-  reader::reader(const std::string& fpath) {
+  reader::reader(const std::string& fpath) : m_context(*this) {
+    m_document.set_skip_contents(skips_contents);
     this->load_file(fpath);
   }
 
   reader::~reader() {
   }
 
-  const std::vector<std::shared_ptr<action::base>>& reader::load_file(const std::string& fpath) {
-    rapidxml_ns::file<> svg_file(fpath.c_str());
-    rapidxml_ns::xml_document<> svg_document;
-    svg_document.parse<0>(svg_file.data());
-
-    rapidxml_ns::xml_node<>* svg_element = svg_document.first_node("svg");
-    rapidxml_ns::xml_attribute<>* attr_width = svg_element->first_attribute("width");
-    rapidxml_ns::xml_attribute<>* attr_height = svg_element->first_attribute("height");
-    if (attr_width) m_width = std::atof(attr_width->value());
-    else std::cerr << "warning: could not determine base width" << std::endl;
-    if (attr_height) m_height = std::atof(attr_height->value());
-    else std::cerr << "warning: could not determine base height" << std::endl;
-
-    if (svg_element) {
-      svgpp::document_traversal<
-        svgpp::processed_elements<processed_element_t>,
-        svgpp::processed_attributes<svgpp::traits::shapes_attributes_by_element>
-          >::load_document(svg_element, m_context);
-    } else {
-      throw std::runtime_error("svg tag not found (is this an SVG file?)");
+  void reader::parse_document(const char* text) {
+    m_document.clear();
+    m_elements_by_id.clear();
+    m_indexed = false;
+    if (!text) return;
+    stats::scope parse_scope(m_stats, stats::STAGE_PARSE);
+    m_document.parse<PARSE_FLAGS>(text);
+  }
+
+  void reader::count_elements(
+      rapidxml_ns::xml_node<>* root,
+      size_t n_repeated,
+      bool count_root)
+  {
+    if (!m_stats || !root) return;
+    std::map<std::string, uint64_t> counts;
+    if (count_root) ++counts[std::string(root->name(), root->name_size())];
+    std::vector<rapidxml_ns::xml_node<>*> stack;
+    for (rapidxml_ns::xml_node<>* child = root->first_node(); child; child = child->next_sibling()) {
+      if (child->type() != rapidxml_ns::node_element) continue;
+      if (n_repeated > 0) {
+        --n_repeated;
+        continue;
+      }
+      stack.push_back(child);
+    }
+    while (!stack.empty()) {
+      rapidxml_ns::xml_node<>* node = stack.back();
+      stack.pop_back();
+      ++counts[std::string(node->name(), node->name_size())];
+      for (rapidxml_ns::xml_node<>* child = node->first_node(); child;
+          child = child->next_sibling())
+      {
+        if (child->type() == rapidxml_ns::node_element) stack.push_back(child);
+      }
+    }
+    m_stats->add_elements(counts);
+  }
+
+  void reader::clear_definitions() {
+    m_definitions.clear();
+    m_definition_paints.clear();
+    m_definition_ids.clear();
+    m_loading.clear();
+    m_missing_ids.clear();
+  }
+
+  size_t reader::load_definition(const std::string& id, const style& paint) {
+    if (std::find(m_loading.begin(), m_loading.end(), id) != m_loading.end()) {
+      std::cerr << "warning: <use> of #" << id << " refers to itself" << std::endl;
+      return NO_DEFINITION;
+    }
+    const auto loaded = m_definition_ids.equal_range(id);
+    for (auto it = loaded.first; it != loaded.second; ++it) {
+      if (m_definition_paints[it->second] == paint) return it->second;
     }
 
+    if (!m_indexed) {
+      std::vector<rapidxml_ns::xml_node<>*> stack;
+      if (m_document.first_node()) stack.push_back(m_document.first_node());
+      while (!stack.empty()) {
+        rapidxml_ns::xml_node<>* node = stack.back();
+        stack.pop_back();
+        rapidxml_ns::xml_attribute<>* attr_id = node->first_attribute("id");
+        if (attr_id) {
+          m_elements_by_id.emplace(std::string(attr_id->value(), attr_id->value_size()), node);
+        }
+        for (rapidxml_ns::xml_node<>* child = node->first_node(); child;
+            child = child->next_sibling())
+        {
+          if (child->type() == rapidxml_ns::node_element) stack.push_back(child);
+        }
+      }
+      m_indexed = true;
+    }
+    const auto element = m_elements_by_id.find(id);
+    if (element == m_elements_by_id.end()) {
+      if (m_missing_ids.insert(id).second) {
+        std::cerr << "warning: <use> refers to unknown element #" << id << std::endl;
+      }
+      return NO_DEFINITION;
+    }
+
+    const size_t index = m_definitions.size();
+    m_definitions.emplace_back();
+    m_definition_paints.push_back(paint);
+    m_definition_ids.emplace(id, index);
+    m_loading.push_back(id);
+    m_context.begin_definition(m_definitions.back(), paint);
+    try {
+      document_traversal_t::load_referenced_element<
+        svgpp::expected_elements<svgpp::traits::reusable_elements>,
+        svgpp::processed_elements<referenced_element_t>
+          >::load(element->second, m_context);
+    } catch (...) {
+      m_context.end_definition();
+      m_loading.pop_back();
+      throw;
+    }
+    m_context.end_definition();
+    m_loading.pop_back();
+    if (m_stats) m_stats->add_commands(m_definitions[index]);
+    return index;
+  }
+
+  const path& reader::load_file(const std::string& fpath) {
+    input::mapped_file svg_file(fpath);
+    m_context.clear();
+    clear_definitions();
+    parse_document(svg_file.data());
+    count_elements(m_document.first_node(), 0, true);
+    load_root(m_document.first_node("svg"), true);
+    // the DOM points into svg_file; drop it but keep the pool's static block
+    parse_document(nullptr);
+
     return this->actions();
   }
 
-  const std::vector<std::shared_ptr<action::base>>& reader::actions() const {
+  const path& reader::load_buffer(const char* data, size_t size) {
+    if (size == 0 || data[size - 1] != '\0') {
+      m_text.assign(data, data + size);
+      m_text.push_back('\0');
+      data = m_text.data();
+    }
+    m_context.clear();
+    clear_definitions();
+    parse_document(data);
+    count_elements(m_document.first_node(), 0, true);
+    load_root(m_document.first_node("svg"), true);
+    parse_document(nullptr);
+
+    return this->actions();
+  }
+
+  void reader::stream_file(
+      const std::string& fpath,
+      const chunk_handler& handler,
+      size_t chunk_size)
+  {
+    const input::mapped_file svg_file(fpath);
+    stream_buffer(svg_file.data(), svg_file.size(), handler, chunk_size);
+  }
+
+  void reader::stream_buffer(
+      const char* data,
+      size_t size,
+      const chunk_handler& handler,
+      size_t chunk_size)
+  {
+    const char* const end = data + size;
+
+    // find the root start tag, skipping the prolog
+    const char* p = static_cast<const char*>(std::memchr(data, '<', size));
+    while (p && !scan::is_element_start(p, end)) {
+      p = scan::skip_markup(p, end);
+      p = static_cast<const char*>(std::memchr(p, '<', end - p));
+    }
+    if (!p) throw std::runtime_error("svg tag not found (is this an SVG file?)");
+
+    bool self_closing = false;
+    const char* const root_begin = p;
+    const char* const root_end = scan::skip_start_tag(p, end, &self_closing);
+    const char* name_end = root_begin + 1;
+    while (name_end < root_end && !std::strchr(" \t\r\n/>", *name_end)) ++name_end;
+    const std::string root_close
+      = self_closing ? "" : "</" + std::string(root_begin + 1, name_end) + ">";
+
+    // each chunk is parsed as a copy of the root start tag wrapping a run of
+    // consecutive top-level children, so at most one chunk's DOM is alive;
+    // top-level <defs> and <symbol> are kept and repeated in every later chunk
+    // so that <use> can refer to them
+    std::vector<char> chunk;
+    std::string definitions;
+    size_t n_definitions = 0;
+    size_t n_counted_definitions = 0; // of those, how many a chunk has been counted with
+    bool first_chunk = true;
+    auto load_chunk = [&](const char* begin, const char* finish) {
+      chunk.assign(root_begin, root_end);
+      chunk.insert(chunk.end(), definitions.begin(), definitions.end());
+      chunk.insert(chunk.end(), begin, finish);
+      chunk.insert(chunk.end(), root_close.begin(), root_close.end());
+      chunk.push_back('\0');
+
+      parse_document(chunk.data());
+      count_elements(m_document.first_node(), n_counted_definitions, first_chunk);
+      n_counted_definitions = n_definitions;
+      m_context.clear();
+      load_root(m_document.first_node(), first_chunk);
+      first_chunk = false;
+      handler(m_context.actions());
+    };
+
+    clear_definitions();
+    const char* group_begin = root_end;
+    p = self_closing ? nullptr : root_end;
+    while (p) {
+      p = static_cast<const char*>(std::memchr(p, '<', end - p));
+      if (!p) throw scan::truncated();
+      if (p[1] == '/') break; // end of the root element
+      if (!scan::is_element_start(p, end)) {
+        p = scan::skip_markup(p, end);
+      } else if (scan::is_definition(p, end)) {
+        if (p > group_begin) load_chunk(group_begin, p);
+        const char* const definition_begin = p;
+        p = scan::skip_element(p, end);
+        definitions.append(definition_begin, p);
+        ++n_definitions;
+        group_begin = p;
+        continue;
+      } else {
+        p = scan::skip_element(p, end);
+      }
+      if (static_cast<size_t>(p - group_begin) >= chunk_size) {
+        load_chunk(group_begin, p);
+        group_begin = p;
+      }
+    }
+    if (first_chunk || (p && p > group_begin)) {
+      load_chunk(group_begin, p ? p : group_begin);
+    }
+    parse_document(nullptr);
+    m_context.clear();
+  }
+
+  // leading number of a length attribute, ignoring its unit, or 0 if there is none
+  inline Float length_value(const rapidxml_ns::xml_attribute<>* attr) {
+    const char* it = attr->value();
+    const char* const end = it + attr->value_size();
+    while (it < end && std::isspace(static_cast<unsigned char>(*it))) ++it;
+    double value = 0;
+    path_data::parse_number(it, end, value);
+    return value;
+  }
+
+  void reader::load_root(rapidxml_ns::xml_node<>* svg_element, bool read_size) {
+    if (!svg_element) {
+      throw std::runtime_error("svg tag not found (is this an SVG file?)");
+    }
+
+    if (read_size) {
+      rapidxml_ns::xml_attribute<>* attr_width = svg_element->first_attribute("width");
+      rapidxml_ns::xml_attribute<>* attr_height = svg_element->first_attribute("height");
+      if (attr_width) m_width = length_value(attr_width);
+      else std::cerr << "warning: could not determine base width" << std::endl;
+      if (attr_height) m_height = length_value(attr_height);
+      else std::cerr << "warning: could not determine base height" << std::endl;
+    }
+
+    {
+      stats::scope traverse_scope(m_stats, stats::STAGE_TRAVERSE);
+      document_traversal_t::load_document(svg_element, m_context);
+    }
+    if (m_stats) m_stats->add_commands(m_context.actions());
+  }
+
+  void reader::set_stats(stats::counters* counters) {
+    m_stats = counters;
+  }
+
+  const path& reader::actions() const {
     return m_context.actions();
   }
 
-  float reader::width() const {
+  const std::deque<path>& reader::definitions() const {
+    return m_definitions;
+  }
+
+  Float reader::width() const {
     return m_width;
   }
 
-  float reader::height() const {
+  Float reader::height() const {
     return m_height;
   }
 } /* namespace svg */
@@ -0,0 +1,63 @@
+#include "thread_pool.hpp"
+
+thread_pool::thread_pool(size_t n_threads) {
+  for (size_t i = 0; i < n_threads; ++i) {
+    m_workers.emplace_back(&thread_pool::work, this);
+  }
+}
+
+thread_pool::~thread_pool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_task_ready.notify_all();
+  for (auto& worker : m_workers) worker.join();
+}
+
+void thread_pool::work() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_task_ready.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+      if (m_tasks.empty()) return;
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+    }
+
+    std::exception_ptr error;
+    try {
+      task();
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (error && !m_error) m_error = error;
+    if (--m_n_pending == 0) m_all_done.notify_all();
+  }
+}
+
+void thread_pool::submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tasks.push_back(std::move(task));
+    ++m_n_pending;
+  }
+  m_task_ready.notify_one();
+}
+
+void thread_pool::wait() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_all_done.wait(lock, [this] { return m_n_pending == 0; });
+  if (m_error) {
+    std::exception_ptr error = m_error;
+    m_error = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+size_t thread_pool::size() const {
+  return m_workers.size();
+}